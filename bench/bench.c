@@ -0,0 +1,471 @@
+#define _GNU_SOURCE
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "bit-map.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC 1
+#endif
+
+#define BENCH_MIN_NS 20000000ULL/*each measurement runs for at least 20ms*/
+#define NS_PER_SEC 1000000000ULL
+#define BENCH_WORK_BYTES (256U * 1024U)/*work copies of bm1 per chunk, sized to stay in L2*/
+#define ARRAY_LEN(a) (sizeof(a) / sizeof((a)[0]))
+
+typedef enum
+{
+    DENSITY_SPARSE,/*1% of the values, uniformly spread*/
+    DENSITY_CLUSTERED,/*runs of 64 values covering about 10%*/
+    DENSITY_DENSE/*50% of the values, uniformly spread*/
+}density_t;
+
+typedef struct
+{
+    struct bitmap *bm1;
+    struct bitmap *bm2;
+    struct bitmap **works;/*copies of bm1 for the operations that modify their input*/
+    u32 work_count;
+    char *text;
+    u16 *absent;/*values missing from bm1 in random order, every add is a real insertion*/
+    u32 absent_len;
+    u16 *present;/*values of bm1 in random order, every del is a real removal*/
+    u32 present_len;
+}bench_ctx_t;
+
+typedef void (*bench_fn_t)(bench_ctx_t *ctx, u32 i);/*i is the index of the call inside its chunk*/
+
+typedef struct
+{
+    const char *name;
+    bench_fn_t fn;
+    bool mutates;/*the work copies are reset from bm1, untimed, between chunks*/
+}bench_op_t;
+
+static const char *density_names[] = {"sparse", "clustered", "dense"};
+static const u16 capacities[] = {1024U, 16384U, 65535U};
+
+/*
+ * with glibc every allocation, including the ones libc makes for strdup, goes through these wrappers so the bytes
+ * requested per operation can be reported
+ */
+#ifdef __GLIBC__
+#define HAVE_ALLOC_STATS 1
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t num, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+static u64 bytes_allocated = 0;
+
+void *malloc(size_t size)
+{
+    bytes_allocated += size;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t num, size_t size)
+{
+    bytes_allocated += num * size;
+    return __libc_calloc(num, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    bytes_allocated += size;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    __libc_free(ptr);
+}
+#else
+static u64 bytes_allocated = 0;
+#endif
+
+static u64 now_ns(void)
+{
+    struct timespec ts = {0};
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (u64)ts.tv_sec * NS_PER_SEC + (u64)ts.tv_nsec;
+}
+
+static u64 cycles(void)
+{
+#ifdef HAVE_RDTSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static u32 xorshift(u32 *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+
+    return *state;
+}
+
+static struct bitmap* make_bitmap(u16 capacity, density_t density, u32 seed)
+{
+    struct bitmap *bm = bitmap_create(capacity);
+    u32 *words = (u32*)calloc(bm->buf_len, sizeof(u32));
+    u32 state = seed;
+    u32 value = 0;
+    u32 end = 0;
+
+    for(value = 0; value < capacity; value++)
+    {
+        switch(density)
+        {
+        case DENSITY_SPARSE:
+            if(xorshift(&state) % 100U == 0)
+                words[value >> 5] |= 1U << (value & 0x1FU);
+            break;
+
+        case DENSITY_CLUSTERED:
+            if(value % 64U != 0 || xorshift(&state) % 10U != 0)
+                break;
+
+            for(end = value + 64U < capacity ? value + 64U : capacity; value < end; value++)
+                words[value >> 5] |= 1U << (value & 0x1FU);
+
+            value--;
+            break;
+
+        case DENSITY_DENSE:
+            if(xorshift(&state) & 1U)
+                words[value >> 5] |= 1U << (value & 0x1FU);
+            break;
+        }
+    }
+
+    bitmap_load_words(bm, words, bm->buf_len);
+    free(words);
+
+    return bm;
+}
+
+/*same ranges format as bitmap_print, used as input of the parse benchmark*/
+static char* make_text(struct bitmap *bm)
+{
+    char *text = (char*)malloc((size_t)bm->numbers * 12U + 16U);
+    size_t len = 0;
+    u32 value = 1;
+    u32 start = 0;
+
+    text[0] = '\0';
+
+    while(value <= bm->max_value)
+    {
+        if((bm->buf[(value - 1U) >> 5] >> ((value - 1U) & 0x1FU) & 1U) == 0)
+        {
+            value++;
+            continue;
+        }
+
+        for(start = value; value + 1U <= bm->max_value && (bm->buf[value >> 5] >> (value & 0x1FU) & 1U); value++);
+
+        len += (size_t)sprintf(text + len, start == value ? "%s%u" : "%s%u-%u", len == 0 ? "" : ",", start, value);
+        value++;
+    }
+
+    if(len == 0)
+        strcpy(text, "1");
+
+    return text;
+}
+
+static void shuffle(u16 *pool, u32 len, u32 *state)
+{
+    u32 i = 0;
+    u32 j = 0;
+    u16 tmp = 0;
+
+    for(i = len; i > 1; i--)
+    {
+        j = xorshift(state) % i;
+        tmp = pool[i - 1U];
+        pool[i - 1U] = pool[j];
+        pool[j] = tmp;
+    }
+
+    return;
+}
+
+/*splits the values of bm1 into the shuffled present and absent pools*/
+static void make_pools(bench_ctx_t *ctx, u32 *state)
+{
+    u32 value = 0;
+
+    ctx->present = (u16*)malloc(ctx->bm1->max_value * sizeof(u16));
+    ctx->absent = (u16*)malloc(ctx->bm1->max_value * sizeof(u16));
+    ctx->present_len = 0;
+    ctx->absent_len = 0;
+
+    for(value = 1; value <= ctx->bm1->max_value; value++)
+    {
+        if(ctx->bm1->buf[(value - 1U) >> 5] >> ((value - 1U) & 0x1FU) & 1U)
+            ctx->present[ctx->present_len++] = (u16)value;
+        else
+            ctx->absent[ctx->absent_len++] = (u16)value;
+    }
+
+    shuffle(ctx->present, ctx->present_len, state);
+    shuffle(ctx->absent, ctx->absent_len, state);
+
+    return;
+}
+
+static void reset_works(bench_ctx_t *ctx, u32 count)
+{
+    u32 i = 0;
+
+    for(i = 0; i < count && i < ctx->work_count; i++)
+        bitmap_copy(ctx->works[i], ctx->bm1);
+
+    return;
+}
+
+static void op_create(bench_ctx_t *ctx, u32 i)
+{
+    (void)i;
+    bitmap_destroy(bitmap_create(ctx->bm1->max_value));
+}
+
+static void op_clone(bench_ctx_t *ctx, u32 i)
+{
+    (void)i;
+    bitmap_destroy(bitmap_clone(ctx->bm1));
+}
+
+static void op_add(bench_ctx_t *ctx, u32 i)
+{
+    bitmap_add_value(ctx->works[i / ctx->absent_len], ctx->absent[i % ctx->absent_len]);
+}
+
+static void op_del(bench_ctx_t *ctx, u32 i)
+{
+    bitmap_del_value(ctx->works[i / ctx->present_len], ctx->present[i % ctx->present_len]);
+}
+
+static void op_or(bench_ctx_t *ctx, u32 i)
+{
+    bitmap_or(ctx->works[i], ctx->bm2);
+}
+
+static void op_and(bench_ctx_t *ctx, u32 i)
+{
+    bitmap_and(ctx->works[i], ctx->bm2);
+}
+
+static void op_xor(bench_ctx_t *ctx, u32 i)
+{
+    bitmap_xor(ctx->works[i], ctx->bm2);
+}
+
+static void op_not(bench_ctx_t *ctx, u32 i)
+{
+    bitmap_not(ctx->works[i]);
+}
+
+static void op_jaccard(bench_ctx_t *ctx, u32 i)
+{
+    double score = 0;
+
+    (void)i;
+    bitmap_jaccard(ctx->bm1, ctx->bm2, &score);
+}
+
+static void op_parse(bench_ctx_t *ctx, u32 i)
+{
+    (void)i;
+    bitmap_destroy(bitmap_parse_str(ctx->text));
+}
+
+static void op_print(bench_ctx_t *ctx, u32 i)
+{
+    (void)i;
+    bitmap_print(ctx->bm1);
+}
+
+static const bench_op_t ops[] =
+{
+    {"create", op_create, false},
+    {"clone", op_clone, false},
+    {"add", op_add, true},
+    {"del", op_del, true},
+    {"or", op_or, true},
+    {"and", op_and, true},
+    {"xor", op_xor, true},
+    {"not", op_not, true},
+    {"jaccard", op_jaccard, false},
+    {"parse", op_parse, false},
+    {"print", op_print, false},
+};
+
+/*calls each work copy takes per chunk, add and del walk their whole pool on one copy before moving to the next*/
+static u32 calls_per_work(const bench_op_t *op, bench_ctx_t *ctx)
+{
+    if(op->fn == op_add)
+        return ctx->absent_len;
+
+    return op->fn == op_del ? ctx->present_len : 1U;
+}
+
+/*
+ * doubles the iteration count until one batch lasts BENCH_MIN_NS, then reports that batch. only the op calls are
+ * timed, ops that modify their input run in chunks and the work copies are reset between chunks outside the clock
+ */
+static void run(const bench_op_t *op, bench_ctx_t *ctx, density_t density, bool *first)
+{
+    u64 iterations = 1;
+    u64 start_ns = 0;
+    u64 elapsed_ns = 0;
+    u64 start_cycles = 0;
+    u64 elapsed_cycles = 0;
+    u64 start_bytes = 0;
+    u64 bytes = 0;
+    u64 done = 0;
+    u64 len = 0;
+    u64 chunk = 0;
+    u32 per_work = calls_per_work(op, ctx);
+    u32 i = 0;
+    int saved_stdout = -1;
+    int null_fd = -1;
+
+    if(per_work == 0)/*nothing to add to a full bitmap or to delete from an empty one*/
+        return;
+
+    chunk = op->mutates ? (u64)ctx->work_count * per_work : ~0ULL;
+
+    if(op->fn == op_print)/*keep the JSON on stdout clean*/
+    {
+        fflush(stdout);
+        saved_stdout = dup(STDOUT_FILENO);
+        null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+    }
+
+    for(;; iterations *= 2U)
+    {
+        elapsed_ns = 0;
+        elapsed_cycles = 0;
+        bytes = 0;
+
+        for(done = 0; done < iterations; done += len)
+        {
+            len = iterations - done < chunk ? iterations - done : chunk;
+            start_bytes = bytes_allocated;
+            start_cycles = cycles();
+            start_ns = now_ns();
+
+            for(i = 0; i < len; i++)
+                op->fn(ctx, i);
+
+            elapsed_ns += now_ns() - start_ns;
+            elapsed_cycles += cycles() - start_cycles;
+            bytes += bytes_allocated - start_bytes;
+
+            if(op->mutates)
+                reset_works(ctx, (u32)((len + per_work - 1U) / per_work));
+        }
+
+        if(elapsed_ns >= BENCH_MIN_NS)
+            break;
+    }
+
+    if(saved_stdout >= 0)
+    {
+        fflush(stdout);
+        dup2(saved_stdout, STDOUT_FILENO);
+        close(saved_stdout);
+        close(null_fd);
+    }
+
+    printf("%s    {\"op\": \"%s\", \"density\": \"%s\", \"capacity\": %u, \"words\": %u, \"iterations\": %llu, "
+        "\"ns_per_op\": %.2f, \"ops_per_sec\": %.0f, ",
+        *first ? "" : ",\n", op->name, density_names[density], ctx->bm1->max_value, ctx->bm1->buf_len,
+        (unsigned long long)iterations, (double)elapsed_ns / iterations, iterations * (double)NS_PER_SEC / elapsed_ns);
+
+#ifdef HAVE_ALLOC_STATS
+    printf("\"bytes_per_op\": %.1f, ", (double)bytes / iterations);
+#else
+    printf("\"bytes_per_op\": null, ");
+#endif
+
+#ifdef HAVE_RDTSC
+    printf("\"cycles_per_word\": %.3f}", (double)elapsed_cycles / iterations / ctx->bm1->buf_len);
+#else
+    printf("\"cycles_per_word\": null}");
+#endif
+
+    *first = false;
+
+    return;
+}
+
+/********************************************************************************************************************
+ * Usage:               bitmap_bench [op ...]
+ * Description          runs every operation(or only the named ones) over each density and capacity and writes one
+ *                      JSON document with a record per measurement to stdout
+ ********************************************************************************************************************/
+int main(int argc, char *argv[])
+{
+    bench_ctx_t ctx = {0};
+    u32 state = 12345U;
+    bool first = true;
+    bool selected = false;
+    u32 c = 0;
+    u32 d = 0;
+    u32 o = 0;
+    int a = 0;
+
+    printf("{\n  \"benchmarks\": [\n");
+
+    for(c = 0; c < ARRAY_LEN(capacities); c++)
+    {
+        for(d = DENSITY_SPARSE; d <= DENSITY_DENSE; d++)
+        {
+            ctx.bm1 = make_bitmap(capacities[c], (density_t)d, 1U + c * 3U + d);
+            ctx.bm2 = make_bitmap(capacities[c], (density_t)d, 101U + c * 3U + d);
+            ctx.work_count = BENCH_WORK_BYTES / bitmap_size(capacities[c]);
+            ctx.works = (struct bitmap**)malloc(ctx.work_count * sizeof(struct bitmap*));
+            ctx.text = make_text(ctx.bm1);
+            make_pools(&ctx, &state);
+
+            for(o = 0; o < ctx.work_count; o++)
+                ctx.works[o] = bitmap_clone(ctx.bm1);
+
+            for(o = 0; o < ARRAY_LEN(ops); o++)
+            {
+                for(selected = argc == 1, a = 1; a < argc; a++)
+                    selected = selected || strcmp(argv[a], ops[o].name) == 0;
+
+                if(selected == false)
+                    continue;
+
+                reset_works(&ctx, ctx.work_count);
+                run(&ops[o], &ctx, (density_t)d, &first);
+            }
+
+            bitmap_destroy(ctx.bm1);
+            bitmap_destroy(ctx.bm2);
+            for(o = 0; o < ctx.work_count; o++)
+                bitmap_destroy(ctx.works[o]);
+
+            free(ctx.works);
+            free(ctx.text);
+            free(ctx.present);
+            free(ctx.absent);
+        }
+    }
+
+    printf("\n  ]\n}\n");
+
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include "bit-map.h"
 #include "error.h"
+#include "stats.h"
 
 #define U16_NUM_DIGITS 5U
 #define U16_MAX UINT16_MAX
@@ -33,38 +34,71 @@ static void first_update(struct bitmap* bm, u16 min_index_hint, u16 max_index_hi
 static void last_update(struct bitmap* bm, u16 min_index_hint, u16 max_index_hint);
 static void bitmap_reset_padding(struct bitmap* bm);
 static void bitmap_add_range(struct bitmap* bm, range_t range);
+static bool bitmap_is_valid(struct bitmap *bm);
+static u32 intersect_count(struct bitmap *bm1, struct bitmap *bm2);
+static bool same_capacity(struct bitmap *bm_dst, struct bitmap *bm1, struct bitmap *bm2);
+static void clear_outside(struct bitmap *bm, u16 start_block, u16 end_block);
 
-struct bitmap* bitmap_create(u16 capacity)
+/*bytes needed by a bitmap holding values 1..capacity, 0 for an invalid capacity*/
+size_t bitmap_size(u16 capacity)
 {
-    struct bitmap *bm = NULL;
-    u16 buf_len = 0;
-    
     if(capacity == 0)
-        return NULL;
+        return 0;
 
-    buf_len = BLOCK_INDEX(capacity) + 1;
-    bm = (struct bitmap*)calloc(sizeof(struct bitmap) + buf_len * sizeof(u32), 1);
+    return sizeof(struct bitmap) + (BLOCK_INDEX(capacity) + 1U) * sizeof(u32);
+}
+
+/*builds an empty bitmap inside caller owned memory of at least bitmap_size(capacity) bytes, it must not be passed to bitmap_destroy*/
+struct bitmap* bitmap_init(void *mem, u16 capacity)
+{
+    struct bitmap *bm = NULL;
+    u16 buf_len = 0;
 
-    if (bm == NULL)
+    if(mem == NULL || capacity == 0)
         return NULL;
 
+    buf_len = BLOCK_INDEX(capacity) + 1;
+    bm = (struct bitmap*)mem;
+    memset(bm, 0, bitmap_size(capacity));
     bm->bm_self = bm;
     bm->max_value = capacity;
     bm->first_value = bm->last_value = bm->numbers = 0;
     bm->buf_len = buf_len;
-    
+
     return bm;
 }
 
+struct bitmap* bitmap_create(u16 capacity)
+{
+    void *mem = NULL;
+    
+    STATS_SCOPE(STAT_CREATE);
+
+    if(capacity == 0)
+        return NULL;
+
+    mem = malloc(bitmap_size(capacity));
+
+    if (mem == NULL)
+        return NULL;
+
+    STATS_ALLOC(STAT_CREATE, bitmap_size(capacity));
+
+    return bitmap_init(mem, capacity);
+}
+
 static bool bitmap_check(struct bitmap *bm)
 {
     struct bitmap* clone_bm = NULL;
     u16 i = 0;
 
+    STATS_SCOPE(STAT_CHECK);
+
     if(bm == NULL || bm != bm->bm_self || bm->buf_len == 0)
         return false;
 
     clone_bm = bitmap_clone(bm);
+    STATS_WORDS(STAT_CHECK, bm->buf_len);
     first_update(clone_bm, 0, clone_bm->buf_len - 1);
     last_update(clone_bm, 0, clone_bm->buf_len - 1);
     bm->numbers = 0;
@@ -98,17 +132,21 @@ struct bitmap* bitmap_clone(struct bitmap *bm)
 {
     struct bitmap *clone = NULL;
     
+    STATS_SCOPE(STAT_CLONE);
+
     if(bm == NULL || bm != bm->bm_self)
     {
         HALT_AND_CONTINUE("Couldn't clone bitmap");
         return NULL;
     }
        
-    clone = bitmap_create(bm->max_value);
+    clone = bitmap_init(malloc(bitmap_size(bm->max_value)), bm->max_value);/*not bitmap_create, the allocation is the clone's*/
 
     if (clone != NULL)
     {
+        STATS_ALLOC(STAT_CLONE, bitmap_size(bm->max_value));
         memcpy(clone->buf, bm->buf, bm->buf_len * sizeof(u32));
+        STATS_WORDS(STAT_CLONE, bm->buf_len);
         clone->first_value = bm->first_value;
         clone->last_value = bm->last_value;
         clone->numbers = bm->numbers;
@@ -123,6 +161,8 @@ bool bitmap_add_value(struct bitmap *bm, u16 value)
     u16 index = 0;
     u32 mask = 0;
 
+    STATS_SCOPE(STAT_ADD);
+
     if (bitmap_check(bm) == false)
     {
         HALT_AND_CONTINUE("The bitmap does not exist or, not a valid bitmap");
@@ -138,6 +178,7 @@ bool bitmap_add_value(struct bitmap *bm, u16 value)
     
     index = BLOCK_INDEX(value);
     mask = MASK(value);
+    STATS_WORDS(STAT_ADD, 1);
 
     if (bm->buf[index] & mask)
         return true;
@@ -191,11 +232,14 @@ bool bitmap_del_value(struct bitmap *bm, u16 value_to_delete)
     u16 index = 0;
     u32 mask = 0;
 
+    STATS_SCOPE(STAT_DEL);
+
     if (bitmap_check(bm) == false || OUT_RANGE(1, value_to_delete, bm->max_value))
         return false;
 
     index = BLOCK_INDEX(value_to_delete);
     mask = MASK(value_to_delete);
+    STATS_WORDS(STAT_DEL, 1);
 
     if ((bm->buf[index] & mask) == 0)/*already deleted*/
         return true;
@@ -244,6 +288,8 @@ bool bitmap_not(struct bitmap *bm)
 {
     u16 i = 0;
 
+    STATS_SCOPE(STAT_NOT);
+
     if (bitmap_check(bm) == false)
         return false;
 
@@ -251,6 +297,7 @@ bool bitmap_not(struct bitmap *bm)
         bm->buf[i] = ~bm->buf[i];
 
     bitmap_reset_padding(bm);
+    STATS_WORDS(STAT_NOT, bm->buf_len);
     bm->numbers = bm->max_value - bm->numbers;
 
     if(bm->numbers == 0)
@@ -271,6 +318,8 @@ bool bitmap_or(struct bitmap *bm_store, struct bitmap *bm)
     u16 start_block = 0;
     u16 end_block = 0;
 
+    STATS_SCOPE(STAT_OR);
+
     if (bitmap_check(bm_store) == false || bitmap_check(bm) == false)
         return false;
     
@@ -289,7 +338,22 @@ bool bitmap_or(struct bitmap *bm_store, struct bitmap *bm)
 
     while(i < end_block)
         bm_store->numbers += count_ones(bm_store->buf[i++]);        
+
+    STATS_WORDS(STAT_OR, end_block > start_block ? end_block - start_block : 0);
     
+    if(bm_store->numbers == 0)
+    {
+        bm_store->first_value = bm_store->last_value = 0;
+        return true;
+    }
+
+    if(bm_store->first_value == 0)/*store was empty, the old bounds give no hint*/
+    {
+        first_update(bm_store, 0, bm_store->buf_len - 1);
+        last_update(bm_store, 0, bm_store->buf_len - 1);
+        return true;
+    }
+
     first_update(bm_store, 0, BLOCK_INDEX(bm_store->first_value));
     last_update(bm_store, BLOCK_INDEX(bm_store->last_value), bm_store->buf_len - 1);
 
@@ -302,6 +366,8 @@ bool bitmap_and(struct bitmap *bm_store, struct bitmap *bm)
     u16 start_block = 0;
     u16 end_block = 0;
 
+    STATS_SCOPE(STAT_AND);
+
     if (bitmap_check(bm_store) == false || bitmap_check(bm) == false)
         return false;
 
@@ -321,12 +387,440 @@ bool bitmap_and(struct bitmap *bm_store, struct bitmap *bm)
     while(i < end_block)
         bm_store->buf[i++] = 0;
 
+    STATS_WORDS(STAT_AND, end_block > start_block ? end_block - start_block : 0);
+
+    if(bm_store->numbers == 0)/*also covers an empty operand, whose bounds are 0*/
+    {
+        bm_store->first_value = bm_store->last_value = 0;
+        return true;
+    }
+
     first_update(bm_store, MAX(BLOCK_INDEX(bm_store->first_value), BLOCK_INDEX(bm->first_value)), bm_store->buf_len - 1);
     last_update(bm_store, 0, MIN(BLOCK_INDEX(bm_store->last_value), BLOCK_INDEX(bm->last_value)));
         
     return true;
 }
 
+bool bitmap_xor(struct bitmap *bm_store, struct bitmap *bm)
+{
+    u16 i = 0;
+    u16 start_block = 0;
+    u16 end_block = 0;
+
+    STATS_SCOPE(STAT_XOR);
+
+    if (bitmap_check(bm_store) == false || bitmap_check(bm) == false)
+        return false;
+
+    if(bm->numbers == 0)
+        return true;
+
+    start_block = BLOCK_INDEX(bm->first_value);
+    end_block = MIN(BLOCK_INDEX(bm->last_value), bm_store->buf_len - 1U);
+
+    for (i = start_block; i <= end_block; i++)/*only the blocks bm can change, numbers is adjusted per block*/
+    {
+        bm_store->numbers -= count_ones(bm_store->buf[i]);
+        bm_store->buf[i] ^= bm->buf[i];
+    }
+
+    bitmap_reset_padding(bm_store);
+    STATS_WORDS(STAT_XOR, end_block >= start_block ? end_block - start_block + 1U : 0);
+
+    for (i = start_block; i <= end_block; i++)
+        bm_store->numbers += count_ones(bm_store->buf[i]);
+
+    if(bm_store->numbers == 0)
+    {
+        bm_store->first_value = bm_store->last_value = 0;
+        return true;
+    }
+
+    first_update(bm_store, 0, bm_store->buf_len - 1);
+    last_update(bm_store, 0, bm_store->buf_len - 1);
+
+    return true;
+}
+
+/*
+ * bm_dst = bm1 & bm2 and friends below: unlike bitmap_and/or/not they trust the cached metadata of valid bitmaps
+ * instead of rescanning them with bitmap_check, never allocate, and bm_dst may be one of the operands. all bitmaps
+ * must have the same capacity.
+ */
+bool bitmap_and_to(struct bitmap *bm_dst, struct bitmap *bm1, struct bitmap *bm2)
+{
+    u16 i = 0;
+    u16 start_block = 0;
+    u16 end_block = 0;
+
+    STATS_SCOPE(STAT_AND);
+
+    if(same_capacity(bm_dst, bm1, bm2) == false)
+        return false;
+
+    if(bm1->numbers == 0 || bm2->numbers == 0 || bm1->first_value > bm2->last_value || bm2->first_value > bm1->last_value)
+        return bitmap_clear(bm_dst);
+
+    start_block = BLOCK_INDEX(MAX(bm1->first_value, bm2->first_value));
+    end_block = BLOCK_INDEX(MIN(bm1->last_value, bm2->last_value));
+    clear_outside(bm_dst, start_block, end_block);
+    bm_dst->numbers = 0;
+
+    for(i = start_block; i <= end_block; i++)
+    {
+        bm_dst->buf[i] = bm1->buf[i] & bm2->buf[i];
+        bm_dst->numbers += count_ones(bm_dst->buf[i]);
+    }
+
+    STATS_WORDS(STAT_AND, end_block - start_block + 1U);
+
+    if(bm_dst->numbers == 0)
+    {
+        bm_dst->first_value = bm_dst->last_value = 0;
+        return true;
+    }
+
+    first_update(bm_dst, start_block, end_block);
+    last_update(bm_dst, start_block, end_block);
+
+    return true;
+}
+
+bool bitmap_or_to(struct bitmap *bm_dst, struct bitmap *bm1, struct bitmap *bm2)
+{
+    u16 i = 0;
+    u16 first_value = 0;
+    u16 last_value = 0;
+    u16 start_block = 0;
+    u16 end_block = 0;
+
+    STATS_SCOPE(STAT_OR);
+
+    if(same_capacity(bm_dst, bm1, bm2) == false)
+        return false;
+
+    if(bm1->numbers == 0 || bm2->numbers == 0)
+        return bitmap_copy(bm_dst, bm1->numbers == 0 ? bm2 : bm1);
+
+    first_value = MIN(bm1->first_value, bm2->first_value);
+    last_value = MAX(bm1->last_value, bm2->last_value);
+    start_block = BLOCK_INDEX(first_value);
+    end_block = BLOCK_INDEX(last_value);
+    clear_outside(bm_dst, start_block, end_block);
+    bm_dst->numbers = 0;
+
+    for(i = start_block; i <= end_block; i++)
+    {
+        bm_dst->buf[i] = bm1->buf[i] | bm2->buf[i];
+        bm_dst->numbers += count_ones(bm_dst->buf[i]);
+    }
+
+    STATS_WORDS(STAT_OR, end_block - start_block + 1U);
+    bm_dst->first_value = first_value;
+    bm_dst->last_value = last_value;
+
+    return true;
+}
+
+/*bm_dst = bm1 & ~bm2*/
+bool bitmap_andnot_to(struct bitmap *bm_dst, struct bitmap *bm1, struct bitmap *bm2)
+{
+    u16 i = 0;
+    u16 start_block = 0;
+    u16 end_block = 0;
+
+    STATS_SCOPE(STAT_AND);
+
+    if(same_capacity(bm_dst, bm1, bm2) == false)
+        return false;
+
+    if(bm1->numbers == 0)
+        return bitmap_clear(bm_dst);
+
+    if(bm2->numbers == 0 || bm1->first_value > bm2->last_value || bm2->first_value > bm1->last_value)
+        return bitmap_copy(bm_dst, bm1);
+
+    start_block = BLOCK_INDEX(bm1->first_value);
+    end_block = BLOCK_INDEX(bm1->last_value);
+    clear_outside(bm_dst, start_block, end_block);
+    bm_dst->numbers = 0;
+
+    for(i = start_block; i <= end_block; i++)
+    {
+        bm_dst->buf[i] = bm1->buf[i] & ~bm2->buf[i];
+        bm_dst->numbers += count_ones(bm_dst->buf[i]);
+    }
+
+    STATS_WORDS(STAT_AND, end_block - start_block + 1U);
+
+    if(bm_dst->numbers == 0)
+    {
+        bm_dst->first_value = bm_dst->last_value = 0;
+        return true;
+    }
+
+    first_update(bm_dst, start_block, end_block);
+    last_update(bm_dst, start_block, end_block);
+
+    return true;
+}
+
+bool bitmap_not_to(struct bitmap *bm_dst, struct bitmap *bm)
+{
+    u16 i = 0;
+
+    STATS_SCOPE(STAT_NOT);
+
+    if(same_capacity(bm_dst, bm, bm) == false)
+        return false;
+
+    for(i = 0; i < bm->buf_len; i++)
+        bm_dst->buf[i] = ~bm->buf[i];
+
+    bitmap_reset_padding(bm_dst);
+    STATS_WORDS(STAT_NOT, bm->buf_len);
+    bm_dst->numbers = bm->max_value - bm->numbers;
+
+    if(bm_dst->numbers == 0)
+    {
+        bm_dst->first_value = bm_dst->last_value = 0;
+        return true;
+    }
+
+    first_update(bm_dst, 0, bm_dst->buf_len - 1);
+    last_update(bm_dst, 0, bm_dst->buf_len - 1);
+
+    return true;
+}
+
+static bool same_capacity(struct bitmap *bm_dst, struct bitmap *bm1, struct bitmap *bm2)
+{
+    return bitmap_is_valid(bm_dst) && bitmap_is_valid(bm1) && bitmap_is_valid(bm2)
+        && bm_dst->max_value == bm1->max_value && bm1->max_value == bm2->max_value;
+}
+
+/*zeroes the set blocks of bm that lie outside [start_block, end_block], bm's own bounds say where they can be*/
+static void clear_outside(struct bitmap *bm, u16 start_block, u16 end_block)
+{
+    u16 low = 0;
+    u16 high = 0;
+    u32 start = 0;
+    u32 end = 0;
+
+    if(bm->numbers == 0)
+        return;
+
+    low = BLOCK_INDEX(bm->first_value);
+    high = BLOCK_INDEX(bm->last_value);
+
+    if(low < start_block)/*set blocks before the range*/
+    {
+        end = MIN(high + 1U, start_block);
+        memset(bm->buf + low, 0, (end - low) * sizeof(u32));
+    }
+
+    if(high > end_block)/*set blocks after the range*/
+    {
+        start = MAX(low, end_block + 1U);
+        memset(bm->buf + start, 0, (high + 1U - start) * sizeof(u32));
+    }
+
+    return;
+}
+
+/*overwrites bm_dst with bm_src without allocating, both must have the same capacity*/
+bool bitmap_copy(struct bitmap *bm_dst, struct bitmap *bm_src)
+{
+    STATS_SCOPE(STAT_COPY);
+
+    if(bitmap_is_valid(bm_dst) == false || bitmap_is_valid(bm_src) == false || bm_dst->max_value != bm_src->max_value)
+        return false;
+
+    memcpy(bm_dst->buf, bm_src->buf, bm_src->buf_len * sizeof(u32));
+    STATS_WORDS(STAT_COPY, bm_src->buf_len);
+    bm_dst->first_value = bm_src->first_value;
+    bm_dst->last_value = bm_src->last_value;
+    bm_dst->numbers = bm_src->numbers;
+
+    return true;
+}
+
+bool bitmap_clear(struct bitmap *bm)
+{
+    STATS_SCOPE(STAT_CLEAR);
+
+    if(bitmap_is_valid(bm) == false)
+        return false;
+
+    if(bm->numbers != 0)
+    {
+        memset(bm->buf + BLOCK_INDEX(bm->first_value), 0, (BLOCK_INDEX(bm->last_value) - BLOCK_INDEX(bm->first_value) + 1U) * sizeof(u32));
+        STATS_WORDS(STAT_CLEAR, BLOCK_INDEX(bm->last_value) - BLOCK_INDEX(bm->first_value) + 1U);
+    }
+
+    bm->first_value = bm->last_value = bm->numbers = 0;
+
+    return true;
+}
+
+/*keeps the count lowest values of bm and drops the rest in one pass over the blocks*/
+bool bitmap_keep_first(struct bitmap *bm, u16 count)
+{
+    u32 block = 0;
+    u32 kept_block = 0;
+    u16 kept = 0;
+    u16 i = 0;
+    u16 end_block = 0;
+
+    if(bitmap_is_valid(bm) == false)
+        return false;
+
+    if(count >= bm->numbers)
+        return true;
+
+    if(count == 0)
+        return bitmap_clear(bm);
+
+    end_block = BLOCK_INDEX(bm->last_value);
+
+    for(i = BLOCK_INDEX(bm->first_value); kept + count_ones(bm->buf[i]) < count; i++)/*blocks kept whole*/
+        kept += count_ones(bm->buf[i]);
+
+    for(block = bm->buf[i]; kept < count; kept++, block &= block - 1U)/*lowest bits of the block holding the cut*/
+        kept_block |= block & (~block + 1U);
+
+    bm->buf[i] = kept_block;
+    memset(bm->buf + i + 1, 0, (end_block - i) * sizeof(u32));
+    bm->numbers = count;
+    bm->last_value = MULT_BY_32(i) + BIT_SIZE_OF(u32) - __builtin_clz(kept_block);
+
+    return true;
+}
+
+/*replaces the content of bm with len raw blocks (bit i of block b is value 32 * b + i + 1), used by bulk builders*/
+bool bitmap_load_words(struct bitmap *bm, const u32 *words, u16 len)
+{
+    u16 i = 0;
+
+    STATS_SCOPE(STAT_LOAD);
+
+    if(bitmap_is_valid(bm) == false || words == NULL || len > bm->buf_len)
+        return false;
+
+    memcpy(bm->buf, words, len * sizeof(u32));
+    memset(bm->buf + len, 0, (bm->buf_len - len) * sizeof(u32));
+    bitmap_reset_padding(bm);
+    STATS_WORDS(STAT_LOAD, bm->buf_len);
+    bm->numbers = 0;
+
+    for(i = 0; i < len; i++)
+        bm->numbers += count_ones(bm->buf[i]);
+
+    if(bm->numbers == 0)
+    {
+        bm->first_value = bm->last_value = 0;
+        return true;
+    }
+
+    first_update(bm, 0, bm->buf_len - 1);
+    last_update(bm, 0, bm->buf_len - 1);
+
+    return true;
+}
+
+/*cheap validity check for the read-only similarity kernels, they do not rescan the bitmap like bitmap_check*/
+static bool bitmap_is_valid(struct bitmap *bm)
+{
+    return bm != NULL && bm == bm->bm_self && bm->buf_len != 0;
+}
+
+/*counts |bm1 & bm2| reading both buffers once, only over the blocks where both sets can overlap*/
+static u32 intersect_count(struct bitmap *bm1, struct bitmap *bm2)
+{
+    const u32 *buf1 = NULL;
+    const u32 *buf2 = NULL;
+    u32 count0 = 0;
+    u32 count1 = 0;
+    u32 count2 = 0;
+    u32 count3 = 0;
+    u16 i = 0;
+    u16 start_block = 0;
+    u16 end_block = 0;
+
+    STATS_SCOPE(STAT_INTERSECT);
+
+    if(bm1->numbers == 0 || bm2->numbers == 0 || bm1->first_value > bm2->last_value || bm2->first_value > bm1->last_value)
+        return 0;
+
+    start_block = BLOCK_INDEX(MAX(bm1->first_value, bm2->first_value));
+    end_block = BLOCK_INDEX(MIN(bm1->last_value, bm2->last_value));
+    STATS_WORDS(STAT_INTERSECT, 2U * (end_block - start_block + 1U));
+    buf1 = bm1->buf;
+    buf2 = bm2->buf;
+    i = start_block;
+
+    for(; i + 3U <= end_block; i += 4U)/*independent accumulators so the compiler can vectorize the loop*/
+    {
+        count0 += count_ones(buf1[i] & buf2[i]);
+        count1 += count_ones(buf1[i + 1U] & buf2[i + 1U]);
+        count2 += count_ones(buf1[i + 2U] & buf2[i + 2U]);
+        count3 += count_ones(buf1[i + 3U] & buf2[i + 3U]);
+    }
+
+    for(; i <= end_block; i++)
+        count0 += count_ones(buf1[i] & buf2[i]);
+
+    return count0 + count1 + count2 + count3;
+}
+
+bool bitmap_and_count(struct bitmap *bm1, struct bitmap *bm2, u32 *count)
+{
+    if(bitmap_is_valid(bm1) == false || bitmap_is_valid(bm2) == false || count == NULL)
+        return false;
+
+    *count = intersect_count(bm1, bm2);
+
+    return true;
+}
+
+/*|bm1 & bm2| / |bm1 | bm2|, two empty bitmaps are identical so their similarity is 1*/
+bool bitmap_jaccard(struct bitmap *bm1, struct bitmap *bm2, double *similarity)
+{
+    u32 common = 0;
+    u32 total = 0;
+
+    if(bitmap_is_valid(bm1) == false || bitmap_is_valid(bm2) == false || similarity == NULL)
+        return false;
+
+    common = intersect_count(bm1, bm2);
+    total = (u32)bm1->numbers + bm2->numbers - common;
+    *similarity = total == 0 ? 1.0 : (double)common / total;
+
+    return true;
+}
+
+/*number of values present in exactly one of the bitmaps*/
+bool bitmap_hamming(struct bitmap *bm1, struct bitmap *bm2, u32 *distance)
+{
+    if(bitmap_is_valid(bm1) == false || bitmap_is_valid(bm2) == false || distance == NULL)
+        return false;
+
+    *distance = (u32)bm1->numbers + bm2->numbers - 2U * intersect_count(bm1, bm2);
+
+    return true;
+}
+
+/*fraction of bm_part that is also in bm_whole, an empty bm_part is fully contained*/
+bool bitmap_containment(struct bitmap *bm_part, struct bitmap *bm_whole, double *ratio)
+{
+    if(bitmap_is_valid(bm_part) == false || bitmap_is_valid(bm_whole) == false || ratio == NULL)
+        return false;
+
+    *ratio = bm_part->numbers == 0 ? 1.0 : (double)intersect_count(bm_part, bm_whole) / bm_part->numbers;
+
+    return true;
+}
+
 void bitmap_print(struct bitmap *bm)
 {
     u16 i = 0;
@@ -338,6 +832,8 @@ void bitmap_print(struct bitmap *bm)
     u16 end_index = 0;
     u32 temp_block = 0;
 
+    STATS_SCOPE(STAT_PRINT);
+
     if (!bitmap_check(bm))
     {
         printf("(nil)\n");
@@ -354,6 +850,7 @@ void bitmap_print(struct bitmap *bm)
     i = BLOCK_INDEX(bm->first_value);
     bit_index = MULT_BY_32(i) + 1;
     first_print_flag = true;
+    STATS_WORDS(STAT_PRINT, end_index - i + 1U);
 
     for(; i <= end_index; i++)
     {
@@ -447,6 +944,8 @@ struct bitmap* bitmap_parse_str(char *str)
     range_t range = {0};
     range_t prev_range = {0};
     
+    STATS_SCOPE(STAT_PARSE);
+
     str_wrk_cpy = strdup(str);/*malloc allocated*/
     tmp = strrchr(str_wrk_cpy, CHAR_COMMA);
     range = find_range(tmp == NULL ? str_wrk_cpy : tmp + 1);
@@ -496,12 +995,16 @@ struct bitmap* bitmap_parse_str(char *str)
     }
 
     bitmap_add_range(bm, range);
+    free(str_wrk_cpy);
 
     return bm;
 }
 
 static u8 count_ones(u32 n) 
 {
+#if defined(__GNUC__)
+    return (u8)__builtin_popcount(n);/*single popcnt instruction when the target has one*/
+#else
     u8 count = 0;
 
     while(n)
@@ -511,6 +1014,7 @@ static u8 count_ones(u32 n)
     }
 
     return count;
+#endif
 }
 
 static range_t find_range(char* str)
@@ -590,7 +1094,10 @@ static void first_update(struct bitmap* bm, u16 min_index_hint, u16 max_index_hi
     u16 i = 0;
     u16 j = 0;
 
+    STATS_SCOPE(STAT_FIRST_UPDATE);
+
     for(i = min_index_hint; i < max_index_hint && bm->buf[i] == 0; i++);
+    STATS_WORDS(STAT_FIRST_UPDATE, i - min_index_hint + 1U);
     temp_block = bm->buf[i];
 
     if(temp_block == 0)
@@ -618,8 +1125,11 @@ static void last_update(struct bitmap* bm, u16 min_index_hint, u16 max_index_hin
     u16 i = 0;
     u16 j = 0;
 
+    STATS_SCOPE(STAT_LAST_UPDATE);
+
     for(i = max_index_hint; i > min_index_hint && bm->buf[i] == 0; i--);
 
+    STATS_WORDS(STAT_LAST_UPDATE, max_index_hint - i + 1U);
     temp_block = bm->buf[i];
     if(temp_block == 0)
     {
@@ -10,6 +10,7 @@
 typedef uint8_t u8;
 typedef uint16_t u16;
 typedef uint32_t u32;
+typedef uint64_t u64;
 
 struct bitmap 
 {
@@ -27,6 +28,8 @@ typedef struct
     u16 end;
 }range_t;
 
+extern size_t bitmap_size(u16 capacity);
+extern struct bitmap* bitmap_init(void *mem, u16 capacity);
 extern struct bitmap* bitmap_create(u16 capacity);
 extern void bitmap_destroy(struct bitmap *bm);
 extern struct bitmap* bitmap_clone(struct bitmap *bm);
@@ -35,6 +38,19 @@ extern bool bitmap_del_value(struct bitmap *bm, u16 value);
 extern bool bitmap_not(struct bitmap *bm);
 extern bool bitmap_or(struct bitmap *bm_store, struct bitmap *bm);
 extern bool bitmap_and(struct bitmap *bm_store, struct bitmap *bm);
+extern bool bitmap_xor(struct bitmap *bm_store, struct bitmap *bm);
+extern bool bitmap_and_to(struct bitmap *bm_dst, struct bitmap *bm1, struct bitmap *bm2);
+extern bool bitmap_or_to(struct bitmap *bm_dst, struct bitmap *bm1, struct bitmap *bm2);
+extern bool bitmap_andnot_to(struct bitmap *bm_dst, struct bitmap *bm1, struct bitmap *bm2);
+extern bool bitmap_not_to(struct bitmap *bm_dst, struct bitmap *bm);
+extern bool bitmap_copy(struct bitmap *bm_dst, struct bitmap *bm_src);
+extern bool bitmap_clear(struct bitmap *bm);
+extern bool bitmap_keep_first(struct bitmap *bm, u16 count);
+extern bool bitmap_load_words(struct bitmap *bm, const u32 *words, u16 len);
+extern bool bitmap_and_count(struct bitmap *bm1, struct bitmap *bm2, u32 *count);
+extern bool bitmap_jaccard(struct bitmap *bm1, struct bitmap *bm2, double *similarity);
+extern bool bitmap_hamming(struct bitmap *bm1, struct bitmap *bm2, u32 *distance);
+extern bool bitmap_containment(struct bitmap *bm_part, struct bitmap *bm_whole, double *ratio);
 extern void bitmap_print(struct bitmap *bm);
 extern struct bitmap* bitmap_parse_str(char *str);
 
@@ -0,0 +1,332 @@
+#include "bsi.h"
+#include "error.h"
+
+#define LEFT_SHIFT(a, b) ((a) << (b))
+#define RIGHT_SHIFT(a, b) ((a) >> (b))
+#define DIV_BY_32(a) RIGHT_SHIFT(a, 5U)
+#define MOD_32(a) ((a) & 0x1FU)
+#define BIT_OF(value, i) (RIGHT_SHIFT(value, i) & 1U)
+
+static bool bsi_check(struct bsi *index);
+static bool bsi_compare(struct bsi *index, u32 value, struct bitmap *lt, struct bitmap *eq);
+
+/********************************************************************************************************************
+ * Function Name:       bsi_build
+ * Input:               a column of values, number of rows(values[r - 1] belongs to row r)
+ * Output:              bit-sliced index:   on success
+ *                      NULL:               on invalid input or allocation failure
+ * Description          transposes the column into one bitmap per value bit in a single pass over the rows
+ ********************************************************************************************************************/
+struct bsi* bsi_build(const u32 *values, u16 rows)
+{
+    struct bsi *index = NULL;
+    u32 *words = NULL;
+    u32 max_value = 0;
+    u32 bits = 0;
+    u16 buf_len = 0;
+    u16 r = 0;
+    u8 i = 0;
+
+    if(values == NULL || rows == 0)
+        return NULL;
+
+    for(r = 0; r < rows; r++)
+        max_value |= values[r];
+
+    index = (struct bsi*)calloc(1, sizeof(struct bsi));
+
+    if(index == NULL)
+        return NULL;
+
+    index->bsi_self = index;
+    index->rows = rows;
+    index->bit_width = max_value == 0 ? 1U : (u8)(BSI_MAX_BITS - __builtin_clz(max_value));
+    index->exists = bitmap_create(rows);
+    buf_len = index->exists == NULL ? 0 : index->exists->buf_len;
+    words = (u32*)calloc((size_t)index->bit_width * buf_len + 1U, sizeof(u32));
+
+    if(index->exists == NULL || words == NULL || bitmap_not_to(index->exists, index->exists) == false)
+    {
+        free(words);
+        bsi_destroy(index);
+        return NULL;
+    }
+
+    for(r = 0; r < rows; r++)
+    {
+        bits = values[r];
+
+        while(bits)/*only visit the set bits of each value*/
+        {
+            i = (u8)__builtin_ctz(bits);
+            words[(size_t)i * buf_len + DIV_BY_32(r)] |= LEFT_SHIFT(1U, MOD_32(r));
+            bits &= bits - 1U;
+        }
+    }
+
+    for(i = 0; i < index->bit_width; i++)
+    {
+        index->slices[i] = bitmap_create(rows);
+
+        if(index->slices[i] == NULL || bitmap_load_words(index->slices[i], words + (size_t)i * buf_len, buf_len) == false)
+        {
+            free(words);
+            bsi_destroy(index);
+            return NULL;
+        }
+    }
+
+    free(words);
+
+    return index;
+}
+
+void bsi_destroy(struct bsi *index)
+{
+    u8 i = 0;
+
+    if(index == NULL || index != index->bsi_self)
+    {
+        HALT_AND_CONTINUE("bsi not freed!");
+        return;
+    }
+
+    for(i = 0; i < BSI_MAX_BITS; i++)
+        if(index->slices[i] != NULL)
+            bitmap_destroy(index->slices[i]);
+
+    if(index->exists != NULL)
+        bitmap_destroy(index->exists);
+
+    free(index);
+
+    return;
+}
+
+struct bitmap* bsi_lt(struct bsi *index, u32 value)
+{
+    struct bitmap *lt = NULL;
+    struct bitmap *eq = NULL;
+
+    if(bsi_check(index) == false)
+        return NULL;
+
+    lt = bitmap_create(index->rows);
+    eq = bitmap_create(index->rows);
+
+    if(lt == NULL || eq == NULL || bsi_compare(index, value, lt, eq) == false)
+    {
+        if(lt != NULL)
+            bitmap_destroy(lt);
+        lt = NULL;
+    }
+
+    if(eq != NULL)
+        bitmap_destroy(eq);
+
+    return lt;
+}
+
+struct bitmap* bsi_le(struct bsi *index, u32 value)
+{
+    struct bitmap *lt = NULL;
+    struct bitmap *eq = NULL;
+
+    if(bsi_check(index) == false)
+        return NULL;
+
+    lt = bitmap_create(index->rows);
+    eq = bitmap_create(index->rows);
+
+    if(lt == NULL || eq == NULL || bsi_compare(index, value, lt, eq) == false || bitmap_or_to(lt, lt, eq) == false)
+    {
+        if(lt != NULL)
+            bitmap_destroy(lt);
+        lt = NULL;
+    }
+
+    if(eq != NULL)
+        bitmap_destroy(eq);
+
+    return lt;
+}
+
+struct bitmap* bsi_eq(struct bsi *index, u32 value)
+{
+    struct bitmap *lt = NULL;
+    struct bitmap *eq = NULL;
+
+    if(bsi_check(index) == false)
+        return NULL;
+
+    lt = bitmap_create(index->rows);
+    eq = bitmap_create(index->rows);
+
+    if(lt == NULL || eq == NULL || bsi_compare(index, value, lt, eq) == false)
+    {
+        if(eq != NULL)
+            bitmap_destroy(eq);
+        eq = NULL;
+    }
+
+    if(lt != NULL)
+        bitmap_destroy(lt);
+
+    return eq;
+}
+
+/*rows with low <= value <= high, computed as le(high) & ~lt(low)*/
+struct bitmap* bsi_between(struct bsi *index, u32 low, u32 high)
+{
+    struct bitmap *result = NULL;
+    struct bitmap *below = NULL;
+
+    if(bsi_check(index) == false)
+        return NULL;
+
+    if(low > high)
+        return bitmap_create(index->rows);
+
+    result = bsi_le(index, high);
+    below = low == 0 ? NULL : bsi_lt(index, low);
+
+    if(result == NULL || (low != 0 && below == NULL) || (below != NULL && bitmap_andnot_to(result, result, below) == false))
+    {
+        if(result != NULL)
+            bitmap_destroy(result);
+        result = NULL;
+    }
+
+    if(below != NULL)
+        bitmap_destroy(below);
+
+    return result;
+}
+
+/*sum of the values of the rows in filter(all rows when NULL), one intersection count per slice*/
+bool bsi_sum(struct bsi *index, struct bitmap *filter, u64 *sum)
+{
+    u32 count = 0;
+    u8 i = 0;
+
+    if(bsi_check(index) == false || sum == NULL)
+        return false;
+
+    if(filter == NULL)
+        filter = index->exists;
+
+    *sum = 0;
+
+    for(i = 0; i < index->bit_width; i++)
+    {
+        if(bitmap_and_count(index->slices[i], filter, &count) == false)
+            return false;
+
+        *sum += LEFT_SHIFT((u64)count, i);
+    }
+
+    return true;
+}
+
+/********************************************************************************************************************
+ * Function Name:       bsi_topk
+ * Input:               index, rows to consider(all rows when NULL), k
+ * Output:              bitmap of the k rows with the largest values(fewer if filter has fewer rows), NULL on error
+ * Description          walks the slices from the most significant bit keeping the rows already known to be in the
+ *                      result(greater) and the rows still tied on the prefix(equal). ties at the end are resolved in
+ *                      favor of the lower row numbers.
+ ********************************************************************************************************************/
+struct bitmap* bsi_topk(struct bsi *index, struct bitmap *filter, u16 k)
+{
+    struct bitmap *greater = NULL;
+    struct bitmap *equal = NULL;
+    struct bitmap *candidate = NULL;
+    bool ok = false;
+    u8 i = 0;
+
+    if(bsi_check(index) == false)
+        return NULL;
+
+    greater = bitmap_create(index->rows);
+    equal = filter == NULL ? bitmap_clone(index->exists) : bitmap_clone(filter);
+    candidate = bitmap_create(index->rows);
+    ok = greater != NULL && equal != NULL && candidate != NULL && equal->max_value == index->rows;
+
+    for(i = index->bit_width; ok && i-- > 0;)
+    {
+        ok = bitmap_and_to(candidate, equal, index->slices[i]) && bitmap_or_to(candidate, candidate, greater);
+
+        if(ok == false)
+            break;
+
+        if(candidate->numbers < k)/*every tied row with a 1 here makes the cut*/
+        {
+            ok = bitmap_copy(greater, candidate) && bitmap_andnot_to(equal, equal, index->slices[i]);
+            continue;
+        }
+
+        ok = bitmap_and_to(equal, equal, index->slices[i]);
+
+        if(candidate->numbers == k)
+            break;
+    }
+
+    if(ok && greater->numbers + equal->numbers > k)/*keep the lowest tied rows*/
+        ok = bitmap_keep_first(equal, k - greater->numbers);
+
+    ok = ok && bitmap_or_to(greater, greater, equal);
+
+    if(equal != NULL)
+        bitmap_destroy(equal);
+
+    if(candidate != NULL)
+        bitmap_destroy(candidate);
+
+    if(ok == false && greater != NULL)
+    {
+        bitmap_destroy(greater);
+        greater = NULL;
+    }
+
+    return greater;
+}
+
+static bool bsi_check(struct bsi *index)
+{
+    return index != NULL && index == index->bsi_self && index->exists != NULL;
+}
+
+/*fills lt and eq(created empty by the caller) with the rows below and equal to value, O(bit_width) non-allocating kernels*/
+static bool bsi_compare(struct bsi *index, u32 value, struct bitmap *lt, struct bitmap *eq)
+{
+    struct bitmap *scratch = NULL;
+    bool ok = true;
+    u8 i = 0;
+
+    if(index->bit_width < BSI_MAX_BITS && RIGHT_SHIFT(value, index->bit_width) != 0)/*larger than any stored value*/
+        return bitmap_copy(lt, index->exists);
+
+    scratch = bitmap_create(index->rows);
+
+    if(scratch == NULL || bitmap_copy(eq, index->exists) == false)
+    {
+        if(scratch != NULL)
+            bitmap_destroy(scratch);
+        return false;
+    }
+
+    for(i = index->bit_width; ok && i-- > 0 && eq->numbers != 0;)
+    {
+        if(BIT_OF(value, i))/*rows with a 0 here are below value from now on*/
+        {
+            ok = bitmap_andnot_to(scratch, eq, index->slices[i]) && bitmap_or_to(lt, lt, scratch) &&
+                 bitmap_and_to(eq, eq, index->slices[i]);
+        }
+        else
+            ok = bitmap_andnot_to(eq, eq, index->slices[i]);
+    }
+
+    bitmap_destroy(scratch);
+
+    return ok;
+}
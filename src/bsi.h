@@ -0,0 +1,27 @@
+#ifndef __BSI_H__
+#define __BSI_H__
+
+#include "bit-map.h"
+
+#define BSI_MAX_BITS 32U
+
+/*bit-sliced index over an integer column, row r (1 based) holds a value whose bit i is set in slices[i]*/
+struct bsi
+{
+    struct bsi *bsi_self;
+    u16 rows;
+    u8 bit_width;
+    struct bitmap *exists;/*rows that hold a value*/
+    struct bitmap *slices[BSI_MAX_BITS];
+};
+
+extern struct bsi* bsi_build(const u32 *values, u16 rows);
+extern void bsi_destroy(struct bsi *index);
+extern struct bitmap* bsi_lt(struct bsi *index, u32 value);
+extern struct bitmap* bsi_le(struct bsi *index, u32 value);
+extern struct bitmap* bsi_eq(struct bsi *index, u32 value);
+extern struct bitmap* bsi_between(struct bsi *index, u32 low, u32 high);
+extern bool bsi_sum(struct bsi *index, struct bitmap *filter, u64 *sum);
+extern struct bitmap* bsi_topk(struct bsi *index, struct bitmap *filter, u16 k);
+
+#endif/*__BSI_H__*/
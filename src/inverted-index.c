@@ -0,0 +1,593 @@
+#include "inverted-index.h"
+#include "error.h"
+
+#define INITIAL_SLOT_COUNT 64U
+#define ARENA_CHUNK_SIZE 65536U
+#define ARENA_ALIGN(n) (((n) + 7U) & ~(size_t)7U)
+#define FNV_OFFSET 2166136261U
+#define FNV_PRIME 16777619U
+#define NO_NODE UINT32_MAX
+#define OPERATORS " \t\r\n&|~()"
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+typedef enum
+{
+    NODE_TERM,
+    NODE_NOT,
+    NODE_AND,
+    NODE_OR
+}node_type_t;
+
+typedef struct
+{
+    node_type_t type;
+    struct bitmap *postings;/*NODE_TERM only, NULL for an unknown term*/
+    u32 estimate;/*upper bound of the result cardinality*/
+    u32 child;
+    u32 next;/*sibling under the same AND/OR*/
+}expr_node_t;
+
+typedef struct
+{
+    struct inv_index *index;
+    const char *pos;
+    expr_node_t *nodes;
+    u32 count;
+    bool error;
+}parser_t;
+
+static void* arena_alloc(struct inv_index *index, size_t size);
+static u32 term_hash(const char *term, size_t len);
+static inv_slot_t* find_slot(struct inv_index *index, const char *term, size_t len, u32 hash);
+static bool grow_slots(struct inv_index *index);
+static struct bitmap* get_or_add_postings(struct inv_index *index, const char *term);
+static u32 new_node(parser_t *parser, node_type_t type);
+static void skip_spaces(parser_t *parser);
+static u32 parse_or(parser_t *parser);
+static u32 parse_and(parser_t *parser);
+static u32 parse_unary(parser_t *parser);
+static u16 plan(struct inv_index *index, expr_node_t *nodes, u32 node);
+static bool reserve_scratch(struct inv_index *index, u16 depth);
+static bool eval(struct inv_index *index, expr_node_t *nodes, u32 node, struct bitmap *out, u16 depth);
+static bool combine(struct inv_index *index, expr_node_t *nodes, node_type_t type, u32 node, struct bitmap *src, struct bitmap *out, u16 depth);
+
+struct inv_index* inv_index_create(u16 capacity)
+{
+    struct inv_index *index = NULL;
+
+    if(capacity == 0)
+        return NULL;
+
+    index = (struct inv_index*)calloc(1, sizeof(struct inv_index));
+
+    if(index == NULL)
+        return NULL;
+
+    index->slots = (inv_slot_t*)calloc(INITIAL_SLOT_COUNT, sizeof(inv_slot_t));
+
+    if(index->slots == NULL)
+    {
+        free(index);
+        return NULL;
+    }
+
+    index->idx_self = index;
+    index->capacity = capacity;
+    index->slot_count = INITIAL_SLOT_COUNT;
+
+    return index;
+}
+
+void inv_index_destroy(struct inv_index *index)
+{
+    inv_chunk_t *chunk = NULL;
+    u16 i = 0;
+
+    if(index == NULL || index != index->idx_self)
+    {
+        HALT_AND_CONTINUE("index not freed!");
+        return;
+    }
+
+    while(index->arena != NULL)/*postings and terms go away with their chunks*/
+    {
+        chunk = index->arena;
+        index->arena = chunk->next;
+        free(chunk);
+    }
+
+    for(i = 0; i < index->scratch_count; i++)
+        bitmap_destroy(index->scratch[i]);
+
+    free(index->scratch);
+    free(index->slots);
+    free(index);
+
+    return;
+}
+
+bool inv_index_add(struct inv_index *index, const char *term, u16 doc)
+{
+    struct bitmap *postings = NULL;
+
+    if(index == NULL || index != index->idx_self || term == NULL || *term == '\0' || term[strcspn(term, OPERATORS)] != '\0')
+        return false;
+
+    if(doc == 0 || doc > index->capacity)/*checked before the term is created*/
+        return false;
+
+    postings = get_or_add_postings(index, term);
+
+    return postings != NULL && bitmap_add_value(postings, doc);
+}
+
+bool inv_index_del(struct inv_index *index, const char *term, u16 doc)
+{
+    struct bitmap *postings = NULL;
+
+    if(index == NULL || index != index->idx_self || term == NULL || doc == 0 || doc > index->capacity)
+        return false;
+
+    postings = inv_index_get(index, term);
+
+    return postings == NULL ? true : bitmap_del_value(postings, doc);/*an unknown term holds no document*/
+}
+
+/*the returned bitmap belongs to the index, it must not be destroyed*/
+struct bitmap* inv_index_get(struct inv_index *index, const char *term)
+{
+    inv_slot_t *slot = NULL;
+    size_t len = 0;
+
+    if(index == NULL || index != index->idx_self || term == NULL)
+        return NULL;
+
+    len = strlen(term);
+    slot = find_slot(index, term, len, term_hash(term, len));
+
+    return slot->term == NULL ? NULL : slot->postings;
+}
+
+/********************************************************************************************************************
+ * Function Name:       inv_index_query
+ * Input:               index, boolean expression over terms, e.g. "a & (b | c) & ~d"
+ * Output:              new bitmap of the matching documents:   on success
+ *                      NULL:                                   on a syntax error or allocation failure
+ * Description          '~' binds tighter than '&', which binds tighter than '|'. AND operands are evaluated in
+ *                      ascending order of their estimated cardinality and evaluation stops at the first empty
+ *                      intermediate. operators run on the non allocating bitmap_*_to kernels, terms and negated
+ *                      terms are read in place and other intermediates go to scratch bitmaps kept by the index, so
+ *                      the result is the only bitmap allocated and concurrent queries on the same index are not
+ *                      allowed.
+ ********************************************************************************************************************/
+struct bitmap* inv_index_query(struct inv_index *index, const char *expr)
+{
+    parser_t parser = {0};
+    struct bitmap *result = NULL;
+    u32 root = NO_NODE;
+    u16 depth = 0;
+
+    if(index == NULL || index != index->idx_self || expr == NULL)
+        return NULL;
+
+    parser.index = index;
+    parser.pos = expr;
+    parser.nodes = (expr_node_t*)malloc((strlen(expr) + 1U) * sizeof(expr_node_t));/*every node consumes at least one character*/
+
+    if(parser.nodes == NULL)
+        return NULL;
+
+    root = parse_or(&parser);
+    skip_spaces(&parser);
+
+    if(parser.error == false && *parser.pos == '\0')
+    {
+        depth = plan(index, parser.nodes, root);
+        result = bitmap_create(index->capacity);
+    }
+
+    if(result != NULL && (reserve_scratch(index, depth) == false || eval(index, parser.nodes, root, result, 0) == false))
+    {
+        bitmap_destroy(result);
+        result = NULL;
+    }
+
+    free(parser.nodes);
+
+    return result;
+}
+
+static u32 parse_or(parser_t *parser)
+{
+    u32 first = NO_NODE;
+    u32 last = NO_NODE;
+    u32 node = NO_NODE;
+
+    first = parse_and(parser);
+    skip_spaces(parser);
+
+    if(parser->error || *parser->pos != '|')
+        return first;
+
+    node = new_node(parser, NODE_OR);
+    parser->nodes[node].child = last = first;
+
+    while(parser->error == false && *parser->pos == '|')
+    {
+        parser->pos++;
+        last = parser->nodes[last].next = parse_and(parser);
+        skip_spaces(parser);
+    }
+
+    return node;
+}
+
+static u32 parse_and(parser_t *parser)
+{
+    u32 first = NO_NODE;
+    u32 last = NO_NODE;
+    u32 node = NO_NODE;
+
+    first = parse_unary(parser);
+    skip_spaces(parser);
+
+    if(parser->error || *parser->pos != '&')
+        return first;
+
+    node = new_node(parser, NODE_AND);
+    parser->nodes[node].child = last = first;
+
+    while(parser->error == false && *parser->pos == '&')
+    {
+        parser->pos++;
+        last = parser->nodes[last].next = parse_unary(parser);
+        skip_spaces(parser);
+    }
+
+    return node;
+}
+
+static u32 parse_unary(parser_t *parser)
+{
+    inv_slot_t *slot = NULL;
+    size_t len = 0;
+    u32 node = NO_NODE;
+
+    skip_spaces(parser);
+
+    if(parser->error)
+        return NO_NODE;
+
+    if(*parser->pos == '~')
+    {
+        parser->pos++;
+        node = new_node(parser, NODE_NOT);
+        parser->nodes[node].child = parse_unary(parser);
+        return node;
+    }
+
+    if(*parser->pos == '(')
+    {
+        parser->pos++;
+        node = parse_or(parser);
+        skip_spaces(parser);
+
+        if(*parser->pos != ')')
+            parser->error = true;
+        else
+            parser->pos++;
+
+        return node;
+    }
+
+    len = strcspn(parser->pos, OPERATORS);
+
+    if(len == 0)
+    {
+        parser->error = true;
+        return NO_NODE;
+    }
+
+    node = new_node(parser, NODE_TERM);
+    slot = find_slot(parser->index, parser->pos, len, term_hash(parser->pos, len));
+    parser->nodes[node].postings = slot->term == NULL ? NULL : slot->postings;
+    parser->pos += len;
+
+    return node;
+}
+
+static u32 new_node(parser_t *parser, node_type_t type)
+{
+    expr_node_t *node = &parser->nodes[parser->count];
+
+    node->type = type;
+    node->postings = NULL;
+    node->estimate = 0;
+    node->child = node->next = NO_NODE;
+
+    return parser->count++;
+}
+
+static void skip_spaces(parser_t *parser)
+{
+    parser->pos += strspn(parser->pos, " \t\r\n");
+
+    return;
+}
+
+/*fills the estimates, sorts AND operands by ascending estimate and returns the scratch depth the subtree needs*/
+static u16 plan(struct inv_index *index, expr_node_t *nodes, u32 node)
+{
+    expr_node_t *n = &nodes[node];
+    u32 sorted = NO_NODE;
+    u32 child = NO_NODE;
+    u32 next = NO_NODE;
+    u32 *link = NULL;
+    u16 depth = 0;
+    u16 child_depth = 0;
+
+    switch(n->type)
+    {
+    case NODE_TERM:
+        n->estimate = n->postings == NULL ? 0 : n->postings->numbers;
+        return 0;
+
+    case NODE_NOT:
+        depth = plan(index, nodes, n->child);
+        n->estimate = index->capacity - MIN(nodes[n->child].estimate, index->capacity);
+        return depth;
+
+    default:
+        break;
+    }
+
+    n->estimate = n->type == NODE_AND ? index->capacity : 0;
+
+    for(child = n->child; child != NO_NODE; child = nodes[child].next)
+    {
+        child_depth = plan(index, nodes, child);
+        depth = MAX(depth, (u16)(child_depth + 1U));/*operands after the first are evaluated one level deeper*/
+
+        if(n->type == NODE_AND)
+            n->estimate = MIN(n->estimate, nodes[child].estimate);
+        else
+            n->estimate = MIN((u32)index->capacity, n->estimate + nodes[child].estimate);
+    }
+
+    if(n->type == NODE_OR)
+        return depth;
+
+    for(child = n->child; child != NO_NODE; child = next)/*insertion sort of the operand list*/
+    {
+        next = nodes[child].next;
+        link = &sorted;
+
+        while(*link != NO_NODE && nodes[*link].estimate <= nodes[child].estimate)
+            link = &nodes[*link].next;
+
+        nodes[child].next = *link;
+        *link = child;
+    }
+
+    n->child = sorted;
+
+    return depth;
+}
+
+static bool eval(struct inv_index *index, expr_node_t *nodes, u32 node, struct bitmap *out, u16 depth)
+{
+    expr_node_t *n = &nodes[node];
+    struct bitmap *src = NULL;
+    u32 child = NO_NODE;
+
+    switch(n->type)
+    {
+    case NODE_TERM:
+        return n->postings == NULL ? bitmap_clear(out) : bitmap_copy(out, n->postings);
+
+    case NODE_NOT:
+        if(nodes[n->child].type == NODE_TERM && nodes[n->child].postings != NULL)
+            return bitmap_not_to(out, nodes[n->child].postings);
+
+        return eval(index, nodes, n->child, out, depth) && bitmap_not_to(out, out);
+
+    default:
+        break;
+    }
+
+    child = n->child;
+
+    if(nodes[child].type == NODE_TERM && nodes[child].postings != NULL)/*a term as first operand is read in place*/
+        src = nodes[child].postings;
+    else if(eval(index, nodes, child, out, depth))
+        src = out;
+    else
+        return false;
+
+    for(child = nodes[child].next; child != NO_NODE; child = nodes[child].next)
+    {
+        if(n->type == NODE_AND ? src->numbers == 0 : src->numbers == index->capacity)/*nothing can change the result*/
+            break;
+
+        if(combine(index, nodes, n->type, child, src, out, depth) == false)
+            return false;
+
+        src = out;
+    }
+
+    return src == out ? true : bitmap_copy(out, src);
+}
+
+/*out = src & operand or src | operand, terms and negated terms are read in place*/
+static bool combine(struct inv_index *index, expr_node_t *nodes, node_type_t type, u32 node, struct bitmap *src, struct bitmap *out, u16 depth)
+{
+    expr_node_t *n = &nodes[node];
+    struct bitmap *tmp = index->scratch[depth];
+
+    if(n->type == NODE_TERM)
+    {
+        if(n->postings == NULL)/*an unknown term is empty*/
+            return type == NODE_AND ? bitmap_clear(out) : (src == out || bitmap_copy(out, src));
+
+        return type == NODE_AND ? bitmap_and_to(out, src, n->postings) : bitmap_or_to(out, src, n->postings);
+    }
+
+    if(type == NODE_AND && n->type == NODE_NOT && nodes[n->child].type == NODE_TERM)/*src & ~term without negating the postings*/
+    {
+        if(nodes[n->child].postings == NULL)
+            return src == out || bitmap_copy(out, src);
+
+        return bitmap_andnot_to(out, src, nodes[n->child].postings);
+    }
+
+    if(eval(index, nodes, node, tmp, depth + 1U) == false)
+        return false;
+
+    return type == NODE_AND ? bitmap_and_to(out, src, tmp) : bitmap_or_to(out, src, tmp);
+}
+
+static bool reserve_scratch(struct inv_index *index, u16 depth)
+{
+    struct bitmap **scratch = NULL;
+
+    if(depth <= index->scratch_count)
+        return true;
+
+    scratch = (struct bitmap**)realloc(index->scratch, depth * sizeof(struct bitmap*));
+
+    if(scratch == NULL)
+        return false;
+
+    index->scratch = scratch;
+
+    while(index->scratch_count < depth)
+    {
+        scratch[index->scratch_count] = bitmap_create(index->capacity);
+
+        if(scratch[index->scratch_count] == NULL)
+            return false;
+
+        index->scratch_count++;
+    }
+
+    return true;
+}
+
+static struct bitmap* get_or_add_postings(struct inv_index *index, const char *term)
+{
+    inv_slot_t *slot = NULL;
+    size_t len = 0;
+    u32 hash = 0;
+
+    len = strlen(term);
+    hash = term_hash(term, len);
+    slot = find_slot(index, term, len, hash);
+
+    if(slot->term != NULL)
+        return slot->postings;
+
+    if(4U * (index->term_count + 1U) > 3U * index->slot_count)/*keep the load factor under 3/4*/
+    {
+        if(grow_slots(index) == false)
+            return NULL;
+
+        slot = find_slot(index, term, len, hash);
+    }
+
+    slot->term = (char*)arena_alloc(index, len + 1U);
+    slot->postings = slot->term == NULL ? NULL : bitmap_init(arena_alloc(index, bitmap_size(index->capacity)), index->capacity);
+
+    if(slot->term == NULL || slot->postings == NULL)
+    {
+        slot->term = NULL;
+        return NULL;
+    }
+
+    memcpy(slot->term, term, len + 1U);
+    slot->hash = hash;
+    index->term_count++;
+
+    return slot->postings;
+}
+
+/*linear probing, returns the slot holding term or the free slot where it belongs*/
+static inv_slot_t* find_slot(struct inv_index *index, const char *term, size_t len, u32 hash)
+{
+    inv_slot_t *slot = NULL;
+    u32 mask = index->slot_count - 1U;
+    u32 i = hash & mask;
+
+    for(;; i = (i + 1U) & mask)
+    {
+        slot = &index->slots[i];
+
+        if(slot->term == NULL || (slot->hash == hash && strncmp(slot->term, term, len) == 0 && slot->term[len] == '\0'))
+            return slot;
+    }
+}
+
+static bool grow_slots(struct inv_index *index)
+{
+    inv_slot_t *old_slots = index->slots;
+    u32 old_count = index->slot_count;
+    u32 i = 0;
+
+    index->slots = (inv_slot_t*)calloc(2U * old_count, sizeof(inv_slot_t));
+
+    if(index->slots == NULL)
+    {
+        index->slots = old_slots;
+        return false;
+    }
+
+    index->slot_count = 2U * old_count;
+
+    for(i = 0; i < old_count; i++)
+        if(old_slots[i].term != NULL)
+            *find_slot(index, old_slots[i].term, strlen(old_slots[i].term), old_slots[i].hash) = old_slots[i];
+
+    free(old_slots);
+
+    return true;
+}
+
+static u32 term_hash(const char *term, size_t len)
+{
+    u32 hash = FNV_OFFSET;
+    size_t i = 0;
+
+    for(i = 0; i < len; i++)
+    {
+        hash ^= (u8)term[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+static void* arena_alloc(struct inv_index *index, size_t size)
+{
+    inv_chunk_t *chunk = index->arena;
+    void *ptr = NULL;
+
+    size = ARENA_ALIGN(size);
+
+    if(chunk == NULL || chunk->size - chunk->used < size)
+    {
+        chunk = (inv_chunk_t*)malloc(sizeof(inv_chunk_t) + MAX(size, (size_t)ARENA_CHUNK_SIZE));
+
+        if(chunk == NULL)
+            return NULL;
+
+        chunk->size = MAX(size, (size_t)ARENA_CHUNK_SIZE);
+        chunk->used = 0;
+        chunk->next = index->arena;
+        index->arena = chunk;
+    }
+
+    ptr = chunk->data + chunk->used;
+    chunk->used += size;
+
+    return ptr;
+}
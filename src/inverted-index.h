@@ -0,0 +1,41 @@
+#ifndef __INVERTED_INDEX_H__
+#define __INVERTED_INDEX_H__
+
+#include "bit-map.h"
+
+typedef struct
+{
+    u32 hash;
+    char *term;/*arena allocated, NULL for a free slot*/
+    struct bitmap *postings;/*arena allocated, documents 1..capacity*/
+}inv_slot_t;
+
+typedef struct inv_chunk
+{
+    struct inv_chunk *next;
+    size_t used;
+    size_t size;
+    u8 data[];
+}inv_chunk_t;
+
+/*term -> bitmap dictionary, postings and term strings live in an arena freed with the index*/
+struct inv_index
+{
+    struct inv_index *idx_self;
+    u16 capacity;
+    u32 term_count;
+    u32 slot_count;/*power of two*/
+    inv_slot_t *slots;
+    inv_chunk_t *arena;
+    u16 scratch_count;
+    struct bitmap **scratch;/*one per expression depth, reused across queries*/
+};
+
+extern struct inv_index* inv_index_create(u16 capacity);
+extern void inv_index_destroy(struct inv_index *index);
+extern bool inv_index_add(struct inv_index *index, const char *term, u16 doc);
+extern bool inv_index_del(struct inv_index *index, const char *term, u16 doc);
+extern struct bitmap* inv_index_get(struct inv_index *index, const char *term);
+extern struct bitmap* inv_index_query(struct inv_index *index, const char *expr);
+
+#endif/*__INVERTED_INDEX_H__*/
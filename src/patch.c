@@ -0,0 +1,575 @@
+#include "patch.h"
+#include "error.h"
+
+/*
+ * patch layout, all integers little endian:
+ *   header:  'B' 'P' version(u8) max_value(u16) base seq(u32) new seq(u32)
+ *            base first_value(u16) last_value(u16) numbers(u16)
+ *            new  first_value(u16) last_value(u16) numbers(u16)
+ *   records: tag(u8) gap(varint) count(varint) [count u32 blocks for PATCH_WORDS]
+ * gap is the distance from the block after the previous record, blocks hold their new absolute value so runs of
+ * cleared or filled blocks cost no payload. a receiver only applies a patch whose base seq is the seq it holds, two
+ * versions with the same first/last/numbers are told apart by their seq.
+ */
+#define PATCH_MAGIC_0 'B'
+#define PATCH_MAGIC_1 'P'
+#define PATCH_VERSION 3U
+#define PATCH_HEADER_LEN 25U
+#define PATCH_SEQ_OFFSET 5U
+#define PATCH_BASE_OFFSET 13U
+#define PATCH_NEW_OFFSET 19U
+#define PATCH_WORDS 0U
+#define PATCH_ZEROS 1U
+#define PATCH_ONES 2U
+#define VARINT_MAX_LEN 5U
+#define U32_MAX UINT32_MAX
+#define BLOCK_INDEX(val) (((val) - 1U) >> 5U)
+#define BIT_INDEX(val) (((val) - 1U) & 0x1FU)
+#define UPTO_MASK(bit) ((2U << (bit)) - 1U)/*bits 0..bit*/
+#define PADDING_MASK(max) ((max) % 32U == 0 ? 0 : U32_MAX << ((max) % 32U))/*bits of the last block past max_value*/
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+typedef struct
+{
+    u8 *data;
+    u32 len;
+    u32 size;
+    u8 run_tag;
+    u32 run_start;
+    u32 run_count;
+    u32 next_block;/*first block after the last written record*/
+    bool error;
+}patch_writer_t;
+
+typedef struct
+{
+    u8 tag;
+    u32 block;
+    u32 count;
+    u32 words;/*offset of the first payload byte of a PATCH_WORDS record*/
+}patch_record_t;
+
+static void writer_init(patch_writer_t *writer, const bitmap_version_t *base, struct bitmap *bm, u32 seq);
+static void writer_push(patch_writer_t *writer, u32 block, u32 value, const u32 *buf);
+static void writer_flush_run(patch_writer_t *writer, const u32 *buf);
+static bool writer_finish(patch_writer_t *writer, const u32 *buf, bitmap_patch_t *patch);
+static void write_bytes(patch_writer_t *writer, const void *bytes, u32 len);
+static void write_u16(patch_writer_t *writer, u16 value);
+static void write_u32(patch_writer_t *writer, u32 value);
+static void write_varint(patch_writer_t *writer, u32 value);
+static bool read_varint(const u8 *data, u32 len, u32 *pos, u32 *value);
+static bool read_record(const bitmap_patch_t *patch, u32 buf_len, u32 *pos, u32 *next_block, patch_record_t *record);
+static u32 record_value(const u8 *data, const patch_record_t *record, u32 i);
+static u16 read_u16(const u8 *data);
+static u32 read_u32(const u8 *data);
+static u32 count_blocks(const u32 *buf, u32 start, u32 end);
+static u8 block_tag(u32 value);
+
+/********************************************************************************************************************
+ * Function Name:       bitmap_diff
+ * Input:               old and new version of a bitmap with the same capacity and their(distinct) seq, patch to fill
+ * Output:              true:   patch->data is malloc allocated, release it with bitmap_patch_free
+ *                      false:  invalid input or allocation failure
+ * Description          encodes the blocks that differ, only the blocks inside either version's first/last bounds
+ *                      are compared
+ ********************************************************************************************************************/
+bool bitmap_diff(struct bitmap *bm_old, u32 old_seq, struct bitmap *bm_new, u32 new_seq, bitmap_patch_t *patch)
+{
+    patch_writer_t writer = {0};
+    bitmap_version_t base = {0};
+    u32 start_block = U32_MAX;
+    u32 end_block = 0;
+    u32 i = 0;
+
+    if(bm_old == NULL || bm_old != bm_old->bm_self || bm_new == NULL || bm_new != bm_new->bm_self || patch == NULL || bm_old->max_value != bm_new->max_value || old_seq == new_seq)
+        return false;
+
+    if(bm_old->numbers != 0)
+    {
+        start_block = BLOCK_INDEX(bm_old->first_value);
+        end_block = BLOCK_INDEX(bm_old->last_value);
+    }
+
+    if(bm_new->numbers != 0)
+    {
+        start_block = MIN(start_block, BLOCK_INDEX(bm_new->first_value));
+        end_block = MAX(end_block, BLOCK_INDEX(bm_new->last_value));
+    }
+
+    base.seq = old_seq;
+    base.first_value = bm_old->first_value;
+    base.last_value = bm_old->last_value;
+    base.numbers = bm_old->numbers;
+    writer_init(&writer, &base, bm_new, new_seq);
+
+    for(i = start_block; i <= end_block && i < bm_new->buf_len; i++)
+        if(bm_old->buf[i] != bm_new->buf[i])
+            writer_push(&writer, i, bm_new->buf[i], bm_new->buf);
+
+    return writer_finish(&writer, bm_new->buf, patch);
+}
+
+/********************************************************************************************************************
+ * Function Name:       bitmap_apply_patch
+ * Input:               bitmap, seq of the version it holds, patch
+ * Output:              true:   bm holds the patched version and *seq its number
+ *                      false:  the patch is malformed or was made against another version, bm and *seq are untouched
+ * Description          validates the whole patch before the first write: the base seq and metadata, every record
+ *                      against the capacity, and the new numbers/first/last against the blocks the patch produces
+ ********************************************************************************************************************/
+bool bitmap_apply_patch(struct bitmap *bm, u32 *seq, const bitmap_patch_t *patch)
+{
+    const u8 *data = NULL;
+    patch_record_t record = {0};
+    u32 pos = PATCH_HEADER_LEN;
+    u32 next_block = 0;
+    u32 numbers = 0;
+    u32 outside = 0;/*set bits left outside the blocks of the new first/last*/
+    u32 low = 0;
+    u32 high = 0;
+    u32 first_word = 0;
+    u32 last_word = 0;
+    u32 block = 0;
+    u32 value = 0;
+    u32 i = 0;
+    u16 first = 0;
+    u16 last = 0;
+
+    if(bm == NULL || bm != bm->bm_self || seq == NULL || patch == NULL || patch->data == NULL || patch->len < PATCH_HEADER_LEN)
+        return false;
+
+    data = patch->data;
+
+    if(data[0] != PATCH_MAGIC_0 || data[1] != PATCH_MAGIC_1 || data[2] != PATCH_VERSION || read_u16(data + 3) != bm->max_value)
+        return false;
+
+    if(read_u32(data + PATCH_SEQ_OFFSET) != *seq || read_u32(data + PATCH_SEQ_OFFSET + 4) == *seq)
+        return false;/*made against another version*/
+
+    if(read_u16(data + PATCH_BASE_OFFSET) != bm->first_value || read_u16(data + PATCH_BASE_OFFSET + 2) != bm->last_value ||
+       read_u16(data + PATCH_BASE_OFFSET + 4) != bm->numbers)
+        return false;/*bm changed outside of the patches*/
+
+    first = read_u16(data + PATCH_NEW_OFFSET);
+    last = read_u16(data + PATCH_NEW_OFFSET + 2);
+
+    if(first > last || last > bm->max_value || (first == 0) != (last == 0))
+        return false;
+
+    numbers = bm->numbers;
+
+    if(first != 0)
+    {
+        low = BLOCK_INDEX(first);
+        high = BLOCK_INDEX(last);
+        first_word = bm->buf[low];
+        last_word = bm->buf[high];
+
+        if(bm->numbers != 0)
+        {
+            outside = count_blocks(bm->buf, BLOCK_INDEX(bm->first_value), MIN(BLOCK_INDEX(bm->last_value) + 1U, low));
+            outside += count_blocks(bm->buf, MAX(BLOCK_INDEX(bm->first_value), high + 1U), BLOCK_INDEX(bm->last_value) + 1U);
+        }
+    }
+
+    while(pos < patch->len)/*validate everything before the first write*/
+    {
+        if(read_record(patch, bm->buf_len, &pos, &next_block, &record) == false)
+            return false;
+
+        for(i = 0; i < record.count; i++)
+        {
+            block = record.block + i;
+            value = record_value(data, &record, i);
+
+            if(block == bm->buf_len - 1U && (value & PADDING_MASK(bm->max_value)) != 0)
+                return false;
+
+            if(first != 0 && (block < low || block > high))
+            {
+                if(value != 0)
+                    return false;/*sets a value outside the new first/last*/
+
+                outside -= __builtin_popcount(bm->buf[block]);
+            }
+
+            first_word = first != 0 && block == low ? value : first_word;
+            last_word = first != 0 && block == high ? value : last_word;
+            numbers = numbers - __builtin_popcount(bm->buf[block]) + __builtin_popcount(value);
+        }
+    }
+
+    if(numbers != read_u16(data + PATCH_NEW_OFFSET + 4) || outside != 0)
+        return false;
+
+    /*first and last are set and nothing lies between them and the edges of their blocks*/
+    if(first != 0 && ((first_word & UPTO_MASK(BIT_INDEX(first))) != 1U << BIT_INDEX(first) || last_word >> BIT_INDEX(last) != 1U))
+        return false;
+
+    for(pos = PATCH_HEADER_LEN, next_block = 0; pos < patch->len;)
+    {
+        read_record(patch, bm->buf_len, &pos, &next_block, &record);
+
+        for(i = 0; i < record.count; i++)
+            bm->buf[record.block + i] = record_value(data, &record, i);
+    }
+
+    bm->numbers = (u16)numbers;
+    bm->first_value = first;
+    bm->last_value = last;
+    *seq = read_u32(data + PATCH_SEQ_OFFSET + 4);
+
+    return true;
+}
+
+void bitmap_patch_free(bitmap_patch_t *patch)
+{
+    if(patch == NULL)
+        return;
+
+    free(patch->data);
+    patch->data = NULL;
+    patch->len = 0;
+
+    return;
+}
+
+struct bitmap_tracker* bitmap_tracker_create(struct bitmap *bm)
+{
+    struct bitmap_tracker *tracker = NULL;
+
+    if(bm == NULL || bm != bm->bm_self)
+        return NULL;
+
+    tracker = (struct bitmap_tracker*)malloc(sizeof(struct bitmap_tracker));
+
+    if(tracker == NULL)
+        return NULL;
+
+    tracker->tr_self = tracker;
+    tracker->bm = bm;
+    tracker->base.seq = 0;
+    tracker->base.first_value = bm->first_value;
+    tracker->base.last_value = bm->last_value;
+    tracker->base.numbers = bm->numbers;
+    tracker->dirty = bitmap_create(bm->buf_len);
+
+    if(tracker->dirty == NULL)
+    {
+        free(tracker);
+        return NULL;
+    }
+
+    return tracker;
+}
+
+/*the tracked bitmap is left alone*/
+void bitmap_tracker_destroy(struct bitmap_tracker *tracker)
+{
+    if(tracker == NULL || tracker != tracker->tr_self)
+    {
+        HALT_AND_CONTINUE("tracker not freed!");
+        return;
+    }
+
+    bitmap_destroy(tracker->dirty);
+    free(tracker);
+
+    return;
+}
+
+bool bitmap_tracker_add_value(struct bitmap_tracker *tracker, u16 value)
+{
+    u16 numbers = 0;
+
+    if(tracker == NULL || tracker != tracker->tr_self)
+        return false;
+
+    numbers = tracker->bm->numbers;
+
+    if(bitmap_add_value(tracker->bm, value) == false)
+        return false;
+
+    return numbers == tracker->bm->numbers ? true : bitmap_add_value(tracker->dirty, BLOCK_INDEX(value) + 1U);/*no-op updates stay clean*/
+}
+
+bool bitmap_tracker_del_value(struct bitmap_tracker *tracker, u16 value)
+{
+    u16 numbers = 0;
+
+    if(tracker == NULL || tracker != tracker->tr_self)
+        return false;
+
+    numbers = tracker->bm->numbers;
+
+    if(bitmap_del_value(tracker->bm, value) == false)
+        return false;
+
+    return numbers == tracker->bm->numbers ? true : bitmap_add_value(tracker->dirty, BLOCK_INDEX(value) + 1U);/*no-op updates stay clean*/
+}
+
+/*encodes the current value of every block touched since the last emit, then forgets them*/
+bool bitmap_tracker_emit(struct bitmap_tracker *tracker, bitmap_patch_t *patch)
+{
+    patch_writer_t writer = {0};
+    struct bitmap *dirty = NULL;
+    u32 word = 0;
+    u32 i = 0;
+
+    if(tracker == NULL || tracker != tracker->tr_self || patch == NULL)
+        return false;
+
+    dirty = tracker->dirty;
+    writer_init(&writer, &tracker->base, tracker->bm, tracker->base.seq + 1U);
+
+    for(i = 0; dirty->numbers != 0 && i < dirty->buf_len; i++)
+    {
+        for(word = dirty->buf[i]; word != 0; word &= word - 1U)
+            writer_push(&writer, 32U * i + __builtin_ctz(word), tracker->bm->buf[32U * i + __builtin_ctz(word)], tracker->bm->buf);
+    }
+
+    if(writer_finish(&writer, tracker->bm->buf, patch) == false)
+        return false;
+
+    tracker->base.seq++;
+    tracker->base.first_value = tracker->bm->first_value;
+    tracker->base.last_value = tracker->bm->last_value;
+    tracker->base.numbers = tracker->bm->numbers;
+
+    return bitmap_clear(dirty);
+}
+
+/*header of a patch turning version base of bm into its current content, numbered seq*/
+static void writer_init(patch_writer_t *writer, const bitmap_version_t *base, struct bitmap *bm, u32 seq)
+{
+    const u8 header[3] = {PATCH_MAGIC_0, PATCH_MAGIC_1, PATCH_VERSION};
+
+    memset(writer, 0, sizeof(patch_writer_t));
+    write_bytes(writer, header, sizeof(header));
+    write_u16(writer, bm->max_value);
+    write_u32(writer, base->seq);
+    write_u32(writer, seq);
+    write_u16(writer, base->first_value);
+    write_u16(writer, base->last_value);
+    write_u16(writer, base->numbers);
+    write_u16(writer, bm->first_value);
+    write_u16(writer, bm->last_value);
+    write_u16(writer, bm->numbers);
+
+    return;
+}
+
+/*blocks must come in ascending order, consecutive blocks of the same kind are merged into one record*/
+static void writer_push(patch_writer_t *writer, u32 block, u32 value, const u32 *buf)
+{
+    u8 tag = block_tag(value);
+
+    if(writer->run_count != 0 && tag == writer->run_tag && block == writer->run_start + writer->run_count)
+    {
+        writer->run_count++;
+        return;
+    }
+
+    writer_flush_run(writer, buf);
+    writer->run_tag = tag;
+    writer->run_start = block;
+    writer->run_count = 1;
+
+    return;
+}
+
+static void writer_flush_run(patch_writer_t *writer, const u32 *buf)
+{
+    u32 i = 0;
+    u8 bytes[4] = {0};
+
+    if(writer->run_count == 0)
+        return;
+
+    write_bytes(writer, &writer->run_tag, 1);
+    write_varint(writer, writer->run_start - writer->next_block);
+    write_varint(writer, writer->run_count);
+
+    for(i = 0; writer->run_tag == PATCH_WORDS && i < writer->run_count; i++)
+    {
+        bytes[0] = (u8)buf[writer->run_start + i];
+        bytes[1] = (u8)(buf[writer->run_start + i] >> 8);
+        bytes[2] = (u8)(buf[writer->run_start + i] >> 16);
+        bytes[3] = (u8)(buf[writer->run_start + i] >> 24);
+        write_bytes(writer, bytes, sizeof(bytes));
+    }
+
+    writer->next_block = writer->run_start + writer->run_count;
+    writer->run_count = 0;
+
+    return;
+}
+
+static bool writer_finish(patch_writer_t *writer, const u32 *buf, bitmap_patch_t *patch)
+{
+    writer_flush_run(writer, buf);
+
+    if(writer->error)
+    {
+        free(writer->data);
+        return false;
+    }
+
+    patch->data = writer->data;
+    patch->len = writer->len;
+
+    return true;
+}
+
+static void write_bytes(patch_writer_t *writer, const void *bytes, u32 len)
+{
+    u8 *data = NULL;
+    u32 size = 0;
+
+    if(writer->error)
+        return;
+
+    if(writer->size - writer->len < len)
+    {
+        size = MAX(2U * writer->size, writer->len + len + 64U);
+        data = (u8*)realloc(writer->data, size);
+
+        if(data == NULL)
+        {
+            writer->error = true;
+            return;
+        }
+
+        writer->data = data;
+        writer->size = size;
+    }
+
+    memcpy(writer->data + writer->len, bytes, len);
+    writer->len += len;
+
+    return;
+}
+
+static void write_u16(patch_writer_t *writer, u16 value)
+{
+    const u8 bytes[2] = {(u8)value, (u8)(value >> 8)};
+
+    write_bytes(writer, bytes, sizeof(bytes));
+
+    return;
+}
+
+static void write_u32(patch_writer_t *writer, u32 value)
+{
+    write_u16(writer, (u16)value);
+    write_u16(writer, (u16)(value >> 16));
+
+    return;
+}
+
+static void write_varint(patch_writer_t *writer, u32 value)
+{
+    u8 bytes[VARINT_MAX_LEN] = {0};
+    u32 len = 0;
+
+    do
+    {
+        bytes[len] = (u8)(value & 0x7FU);
+        value >>= 7U;
+
+        if(value != 0)
+            bytes[len] |= 0x80U;
+
+        len++;
+    } while(value != 0);
+
+    write_bytes(writer, bytes, len);
+
+    return;
+}
+
+static bool read_varint(const u8 *data, u32 len, u32 *pos, u32 *value)
+{
+    u32 shift = 0;
+
+    *value = 0;
+
+    for(shift = 0; *pos < len && shift < 7U * VARINT_MAX_LEN; shift += 7U)
+    {
+        *value |= (u32)(data[*pos] & 0x7FU) << shift;
+
+        if((data[(*pos)++] & 0x80U) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+static u8 block_tag(u32 value)
+{
+    if(value == 0)
+        return PATCH_ZEROS;
+
+    return value == U32_MAX ? PATCH_ONES : PATCH_WORDS;
+}
+
+/*reads one record and checks it against the capacity, records must not overlap or go backwards*/
+static bool read_record(const bitmap_patch_t *patch, u32 buf_len, u32 *pos, u32 *next_block, patch_record_t *record)
+{
+    u32 gap = 0;
+
+    record->tag = patch->data[(*pos)++];
+
+    if(record->tag > PATCH_ONES || read_varint(patch->data, patch->len, pos, &gap) == false ||
+       read_varint(patch->data, patch->len, pos, &record->count) == false)
+        return false;
+
+    if(gap > buf_len - *next_block || record->count > buf_len - *next_block - gap)
+        return false;
+
+    record->block = *next_block + gap;
+    record->words = *pos;
+    *next_block = record->block + record->count;
+
+    if(record->tag != PATCH_WORDS)
+        return true;
+
+    if(patch->len - *pos < 4U * record->count)
+        return false;
+
+    *pos += 4U * record->count;
+
+    return true;
+}
+
+static u32 record_value(const u8 *data, const patch_record_t *record, u32 i)
+{
+    const u8 *bytes = data + record->words + 4U * i;
+
+    if(record->tag != PATCH_WORDS)
+        return record->tag == PATCH_ONES ? U32_MAX : 0;
+
+    return (u32)bytes[0] | (u32)bytes[1] << 8 | (u32)bytes[2] << 16 | (u32)bytes[3] << 24;
+}
+
+static u16 read_u16(const u8 *data)
+{
+    return (u16)(data[0] | data[1] << 8);
+}
+
+static u32 read_u32(const u8 *data)
+{
+    return (u32)read_u16(data) | (u32)read_u16(data + 2) << 16;
+}
+
+/*set bits of blocks start..end - 1*/
+static u32 count_blocks(const u32 *buf, u32 start, u32 end)
+{
+    u32 count = 0;
+
+    for(; start < end; start++)
+        count += __builtin_popcount(buf[start]);
+
+    return count;
+}
@@ -0,0 +1,40 @@
+#ifndef __PATCH_H__
+#define __PATCH_H__
+
+#include "bit-map.h"
+
+/*encoded delta between two versions of a bitmap, data can be sent as is and wrapped again on the receiving side*/
+typedef struct
+{
+    u8 *data;
+    u32 len;
+}bitmap_patch_t;
+
+/*a version of a bitmap, seq is chosen by the sender and grows by one per patch of a tracker*/
+typedef struct
+{
+    u32 seq;
+    u16 first_value;
+    u16 last_value;
+    u16 numbers;
+}bitmap_version_t;
+
+/*records which blocks of bm changed since the last emitted patch*/
+struct bitmap_tracker
+{
+    struct bitmap_tracker *tr_self;
+    struct bitmap *bm;
+    struct bitmap *dirty;/*value b + 1 is set when block b of bm changed*/
+    bitmap_version_t base;/*version of bm the next patch applies to, seq starts at 0*/
+};
+
+extern bool bitmap_diff(struct bitmap *bm_old, u32 old_seq, struct bitmap *bm_new, u32 new_seq, bitmap_patch_t *patch);
+extern bool bitmap_apply_patch(struct bitmap *bm, u32 *seq, const bitmap_patch_t *patch);
+extern void bitmap_patch_free(bitmap_patch_t *patch);
+extern struct bitmap_tracker* bitmap_tracker_create(struct bitmap *bm);
+extern void bitmap_tracker_destroy(struct bitmap_tracker *tracker);
+extern bool bitmap_tracker_add_value(struct bitmap_tracker *tracker, u16 value);
+extern bool bitmap_tracker_del_value(struct bitmap_tracker *tracker, u16 value);
+extern bool bitmap_tracker_emit(struct bitmap_tracker *tracker, bitmap_patch_t *patch);
+
+#endif/*__PATCH_H__*/
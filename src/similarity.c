@@ -0,0 +1,243 @@
+#include <pthread.h>
+#include <unistd.h>
+#include "similarity.h"
+
+#define TOPK_MIN_PER_THREAD 16384U/*below this a thread costs more than the scoring it saves*/
+#define TOPK_MAX_THREADS 64U
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define HEAP_PARENT(i) (((i) - 1U) >> 1U)
+#define HEAP_LEFT(i) (((i) << 1U) + 1U)
+
+typedef struct
+{
+    struct bitmap *query;
+    struct bitmap **collection;
+    u32 begin;
+    u32 end;
+    u32 capacity;/*min(k, end - begin), a chunk never keeps more matches than it has candidates*/
+    u32 heap_len;
+    bitmap_match_t *heap;/*min heap, the root is the worst match kept so far*/
+}topk_worker_t;
+
+static bool match_better(bitmap_match_t a, bitmap_match_t b);
+static int match_compare(const void *a, const void *b);
+static void heap_push(topk_worker_t *worker, bitmap_match_t match);
+static double score_upper_bound(struct bitmap *query, struct bitmap *candidate);
+static void* topk_scan(void *arg);
+static u32 topk_thread_count(u32 n);
+
+/********************************************************************************************************************
+ * Function Name:       bitmap_topk_similar
+ * Input:               query bitmap, array of n bitmaps, k, output array with room for min(k, n) matches
+ * Output:              number of matches written (min(k, valid bitmaps in the collection)),
+ *                      BITMAP_TOPK_ERROR on invalid input or allocation failure
+ * Description          finds the k bitmaps with the highest jaccard similarity to the query, best first, ties are
+ *                      broken by the lower index. candidates whose cardinality bound cannot beat the current k-th
+ *                      match are skipped without touching their buffers. large collections are split among threads.
+ ********************************************************************************************************************/
+u32 bitmap_topk_similar(struct bitmap *query, struct bitmap **collection, u32 n, u32 k, bitmap_match_t *matches)
+{
+    return bitmap_topk_similar_threads(query, collection, n, k, 0, matches);
+}
+
+/*same as bitmap_topk_similar with a fixed number of threads(capped at TOPK_MAX_THREADS and n), 0 picks it from the cpu count*/
+u32 bitmap_topk_similar_threads(struct bitmap *query, struct bitmap **collection, u32 n, u32 k, u32 thread_limit, bitmap_match_t *matches)
+{
+    topk_worker_t workers[TOPK_MAX_THREADS];
+    pthread_t threads[TOPK_MAX_THREADS];
+    bool started[TOPK_MAX_THREADS] = {false};
+    bitmap_match_t *merged = NULL;
+    u32 thread_count = 0;
+    u32 chunk = 0;
+    u32 total = 0;
+    u32 i = 0;
+
+    if(query == NULL || query != query->bm_self || collection == NULL || matches == NULL)
+        return BITMAP_TOPK_ERROR;
+
+    if(n == 0 || k == 0)
+        return 0;
+
+    thread_count = thread_limit == 0 ? topk_thread_count(n) : MIN(MIN(thread_limit, TOPK_MAX_THREADS), n);
+    chunk = n / thread_count;
+
+    for(i = 0; i < thread_count; i++)
+    {
+        workers[i].query = query;
+        workers[i].collection = collection;
+        workers[i].begin = i * chunk;
+        workers[i].end = i == thread_count - 1 ? n : (i + 1) * chunk;
+        workers[i].capacity = MIN(k, workers[i].end - workers[i].begin);
+        workers[i].heap_len = 0;
+        workers[i].heap = (bitmap_match_t*)malloc(workers[i].capacity * sizeof(bitmap_match_t));
+
+        if(workers[i].heap == NULL)
+        {
+            thread_count = i;
+            total = BITMAP_TOPK_ERROR;
+            goto cleanup;
+        }
+    }
+
+    for(i = 1; i < thread_count; i++)/*the calling thread takes the first chunk itself*/
+        started[i] = pthread_create(&threads[i], NULL, topk_scan, &workers[i]) == 0;
+
+    topk_scan(&workers[0]);
+
+    for(i = 1; i < thread_count; i++)
+    {
+        if(started[i])
+            pthread_join(threads[i], NULL);
+        else
+            topk_scan(&workers[i]);
+    }
+
+    for(i = 0; i < thread_count; i++)
+        total += workers[i].heap_len;
+
+    merged = (bitmap_match_t*)malloc((total == 0 ? 1 : total) * sizeof(bitmap_match_t));
+
+    if(merged == NULL)
+    {
+        total = BITMAP_TOPK_ERROR;
+        goto cleanup;
+    }
+
+    total = 0;
+
+    for(i = 0; i < thread_count; i++)
+    {
+        memcpy(merged + total, workers[i].heap, workers[i].heap_len * sizeof(bitmap_match_t));
+        total += workers[i].heap_len;
+    }
+
+    qsort(merged, total, sizeof(bitmap_match_t), match_compare);
+    total = MIN(total, k);
+    memcpy(matches, merged, total * sizeof(bitmap_match_t));
+    free(merged);
+
+cleanup:
+    for(i = 0; i < thread_count; i++)
+        free(workers[i].heap);
+
+    return total;
+}
+
+static void* topk_scan(void *arg)
+{
+    topk_worker_t *worker = (topk_worker_t*)arg;
+    struct bitmap *candidate = NULL;
+    bitmap_match_t match = {0};
+    u32 i = 0;
+
+    for(i = worker->begin; i < worker->end; i++)
+    {
+        candidate = worker->collection[i];
+
+        if(candidate == NULL || candidate != candidate->bm_self)
+            continue;
+
+        /*candidates come in index order, so an equal score never displaces the root*/
+        if(worker->heap_len == worker->capacity && score_upper_bound(worker->query, candidate) <= worker->heap[0].score)
+            continue;
+
+        match.index = i;
+
+        if(bitmap_jaccard(worker->query, candidate, &match.score) == false)
+            continue;
+
+        heap_push(worker, match);
+    }
+
+    return NULL;
+}
+
+/*jaccard can never exceed min(|a|, |b|) / max(|a|, |b|), and is 0 when the value ranges do not overlap*/
+static double score_upper_bound(struct bitmap *query, struct bitmap *candidate)
+{
+    u16 small = 0;
+    u16 large = 0;
+
+    if(query->numbers == 0 || candidate->numbers == 0)
+        return query->numbers == candidate->numbers ? 1.0 : 0.0;
+
+    if(query->first_value > candidate->last_value || candidate->first_value > query->last_value)
+        return 0.0;
+
+    small = MIN(query->numbers, candidate->numbers);
+    large = MAX(query->numbers, candidate->numbers);
+
+    return (double)small / large;
+}
+
+static void heap_push(topk_worker_t *worker, bitmap_match_t match)
+{
+    bitmap_match_t *heap = worker->heap;
+    bitmap_match_t tmp = {0};
+    u32 i = 0;
+    u32 child = 0;
+
+    if(worker->heap_len < worker->capacity)/*sift up*/
+    {
+        i = worker->heap_len++;
+        heap[i] = match;
+
+        while(i > 0 && match_better(heap[HEAP_PARENT(i)], heap[i]))
+        {
+            tmp = heap[i];
+            heap[i] = heap[HEAP_PARENT(i)];
+            heap[HEAP_PARENT(i)] = tmp;
+            i = HEAP_PARENT(i);
+        }
+
+        return;
+    }
+
+    if(match_better(match, heap[0]) == false)
+        return;
+
+    heap[0] = match;
+
+    while((child = HEAP_LEFT(i)) < worker->heap_len)/*sift down*/
+    {
+        if(child + 1U < worker->heap_len && match_better(heap[child], heap[child + 1U]))
+            child++;
+
+        if(match_better(heap[child], heap[i]))
+            break;
+
+        tmp = heap[i];
+        heap[i] = heap[child];
+        heap[child] = tmp;
+        i = child;
+    }
+
+    return;
+}
+
+static bool match_better(bitmap_match_t a, bitmap_match_t b)
+{
+    return a.score > b.score || (a.score == b.score && a.index < b.index);
+}
+
+static int match_compare(const void *a, const void *b)
+{
+    if(match_better(*(const bitmap_match_t*)a, *(const bitmap_match_t*)b))
+        return -1;
+
+    return match_better(*(const bitmap_match_t*)b, *(const bitmap_match_t*)a) ? 1 : 0;
+}
+
+static u32 topk_thread_count(u32 n)
+{
+    long cpus = 0;
+    u32 count = 0;
+
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    count = cpus < 1 ? 1U : (u32)cpus;
+    count = MIN(count, TOPK_MAX_THREADS);
+    count = MIN(count, n / TOPK_MIN_PER_THREAD);
+
+    return count == 0 ? 1U : count;
+}
@@ -0,0 +1,17 @@
+#ifndef __SIMILARITY_H__
+#define __SIMILARITY_H__
+
+#include "bit-map.h"
+
+typedef struct
+{
+    u32 index;/*position in the collection*/
+    double score;/*jaccard similarity with the query*/
+}bitmap_match_t;
+
+#define BITMAP_TOPK_ERROR UINT32_MAX/*invalid input or allocation failure, a search returns at most k otherwise*/
+
+extern u32 bitmap_topk_similar(struct bitmap *query, struct bitmap **collection, u32 n, u32 k, bitmap_match_t *matches);
+extern u32 bitmap_topk_similar_threads(struct bitmap *query, struct bitmap **collection, u32 n, u32 k, u32 thread_limit, bitmap_match_t *matches);
+
+#endif/*__SIMILARITY_H__*/
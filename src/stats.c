@@ -0,0 +1,236 @@
+#include "stats.h"
+
+static const char *op_names[STAT_OP_COUNT] =
+{
+    "create", "clone", "check", "add", "del", "not", "or", "and", "xor", "copy", "clear", "load",
+    "intersect", "print", "parse", "first_update", "last_update"
+};
+
+const char* bitmap_stats_op_name(bitmap_stat_op_t op)
+{
+    return op < STAT_OP_COUNT ? op_names[op] : NULL;
+}
+
+#ifdef BITMAP_STATS
+#include <pthread.h>
+#include <time.h>
+#if defined(BITMAP_STATS_RDTSC) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define LATENCY_UNIT "cycles"
+#else
+#undef BITMAP_STATS_RDTSC
+#define LATENCY_UNIT "ns"
+#endif
+
+#define STATS_LOAD(counter) __atomic_load_n(&(counter), __ATOMIC_RELAXED)
+#define STATS_CLEAR(counter) __atomic_store_n(&(counter), 0, __ATOMIC_RELAXED)
+
+/*one block per live thread, folded into retired_block when the thread exits*/
+typedef struct stats_block
+{
+    struct stats_block *next;
+    bitmap_op_stats_t ops[STAT_OP_COUNT];
+}stats_block_t;
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t exit_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t exit_key;
+static bool exit_key_ok = false;
+static stats_block_t *registry = NULL;
+static __thread stats_block_t *local_block = NULL;
+static stats_block_t fallback_block;/*shared when a thread block cannot be allocated*/
+static stats_block_t retired_block;/*counts of the threads that exited*/
+
+static void ops_accumulate(bitmap_op_stats_t *total, bitmap_op_stats_t *ops);
+static void ops_clear(bitmap_op_stats_t *ops);
+static void thread_exit(void *arg);
+
+static void exit_key_create(void)
+{
+    exit_key_ok = pthread_key_create(&exit_key, thread_exit) == 0;
+
+    return;
+}
+
+bitmap_op_stats_t* bitmap_stats_local(bitmap_stat_op_t op)
+{
+    stats_block_t *block = local_block;
+
+    if(block != NULL)
+        return &block->ops[op];
+
+    pthread_once(&exit_key_once, exit_key_create);
+    block = (stats_block_t*)calloc(1, sizeof(stats_block_t));/*raw calloc, the stats do not count themselves*/
+
+    if(block == NULL || exit_key_ok == false || pthread_setspecific(exit_key, block) != 0)
+    {
+        free(block);/*a block nobody would free at thread exit*/
+        return &fallback_block.ops[op];
+    }
+
+    pthread_mutex_lock(&registry_lock);
+    block->next = registry;
+    registry = block;
+    pthread_mutex_unlock(&registry_lock);
+    local_block = block;
+
+    return &block->ops[op];
+}
+
+/*runs in the exiting thread, its counts move to retired_block so the totals keep them*/
+static void thread_exit(void *arg)
+{
+    stats_block_t *block = (stats_block_t*)arg;
+    stats_block_t **link = NULL;
+    u32 op = 0;
+
+    pthread_mutex_lock(&registry_lock);
+
+    for(link = &registry; *link != NULL && *link != block; link = &(*link)->next);
+
+    if(*link == block)
+        *link = block->next;
+
+    for(op = 0; op < STAT_OP_COUNT; op++)
+        ops_accumulate(&retired_block.ops[op], &block->ops[op]);
+
+    pthread_mutex_unlock(&registry_lock);
+
+    local_block = NULL;/*a later destructor using the library gets a new block*/
+    free(block);
+
+    return;
+}
+
+u64 bitmap_stats_ticks(void)
+{
+#ifdef BITMAP_STATS_RDTSC
+    return __rdtsc();
+#else
+    struct timespec ts = {0};
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (u64)ts.tv_sec * 1000000000ULL + (u64)ts.tv_nsec;
+#endif
+}
+
+void bitmap_stats_scope_end(bitmap_stats_scope_t *scope)
+{
+    bitmap_op_stats_t *stats = bitmap_stats_local(scope->op);
+    u64 ticks = bitmap_stats_ticks() - scope->start;
+    u32 bucket = ticks == 0 ? 0 : 63U - __builtin_clzll(ticks);
+
+    STATS_COUNT(stats->latency_total, ticks);
+    STATS_COUNT(stats->latency_hist[bucket < BITMAP_STATS_BUCKETS ? bucket : BITMAP_STATS_BUCKETS - 1U], 1);
+
+    return;
+}
+
+/********************************************************************************************************************
+ * Function Name:       bitmap_stats_snapshot
+ * Input:               stats to fill
+ * Output:              true:   stats holds the sum over every thread that used the library, exited ones included
+ *                      false:  the library was built without BITMAP_STATS, stats is zeroed
+ * Description          every update that returned before the call is included, an update running at the same time is
+ *                      either included whole or not at all. counters are read one by one while other threads keep
+ *                      counting, so two fields of an op(calls and latency_total, say) may disagree by the updates
+ *                      that were in flight.
+ ********************************************************************************************************************/
+bool bitmap_stats_snapshot(bitmap_stats_t *stats)
+{
+    stats_block_t *block = NULL;
+    u32 op = 0;
+
+    if(stats == NULL)
+        return false;
+
+    memset(stats, 0, sizeof(bitmap_stats_t));
+#ifdef BITMAP_STATS_LATENCY
+    stats->latency_unit = LATENCY_UNIT;
+#endif
+
+    pthread_mutex_lock(&registry_lock);
+
+    for(op = 0; op < STAT_OP_COUNT; op++)
+    {
+        ops_accumulate(&stats->ops[op], &fallback_block.ops[op]);
+        ops_accumulate(&stats->ops[op], &retired_block.ops[op]);
+
+        for(block = registry; block != NULL; block = block->next)
+            ops_accumulate(&stats->ops[op], &block->ops[op]);
+    }
+
+    pthread_mutex_unlock(&registry_lock);
+
+    return true;
+}
+
+/*updates that returned before the call are dropped, one running at the same time is either dropped or kept whole*/
+void bitmap_stats_reset(void)
+{
+    stats_block_t *block = NULL;
+    u32 op = 0;
+
+    pthread_mutex_lock(&registry_lock);
+
+    for(op = 0; op < STAT_OP_COUNT; op++)
+    {
+        ops_clear(&fallback_block.ops[op]);
+        ops_clear(&retired_block.ops[op]);
+
+        for(block = registry; block != NULL; block = block->next)
+            ops_clear(&block->ops[op]);
+    }
+
+    pthread_mutex_unlock(&registry_lock);
+
+    return;
+}
+
+/*total is only seen by the caller, ops may be counting in another thread*/
+static void ops_accumulate(bitmap_op_stats_t *total, bitmap_op_stats_t *ops)
+{
+    u32 i = 0;
+
+    total->calls += STATS_LOAD(ops->calls);
+    total->words += STATS_LOAD(ops->words);
+    total->allocations += STATS_LOAD(ops->allocations);
+    total->bytes += STATS_LOAD(ops->bytes);
+    total->latency_total += STATS_LOAD(ops->latency_total);
+
+    for(i = 0; i < BITMAP_STATS_BUCKETS; i++)
+        total->latency_hist[i] += STATS_LOAD(ops->latency_hist[i]);
+
+    return;
+}
+
+static void ops_clear(bitmap_op_stats_t *ops)
+{
+    u32 i = 0;
+
+    STATS_CLEAR(ops->calls);
+    STATS_CLEAR(ops->words);
+    STATS_CLEAR(ops->allocations);
+    STATS_CLEAR(ops->bytes);
+    STATS_CLEAR(ops->latency_total);
+
+    for(i = 0; i < BITMAP_STATS_BUCKETS; i++)
+        STATS_CLEAR(ops->latency_hist[i]);
+
+    return;
+}
+#else
+bool bitmap_stats_snapshot(bitmap_stats_t *stats)
+{
+    if(stats != NULL)
+        memset(stats, 0, sizeof(bitmap_stats_t));
+
+    return false;
+}
+
+void bitmap_stats_reset(void)
+{
+    return;
+}
+#endif
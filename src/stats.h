@@ -0,0 +1,88 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include "bit-map.h"
+
+#define BITMAP_STATS_BUCKETS 32U/*bucket i counts latencies in [2^i, 2^(i+1)) ticks*/
+
+typedef enum
+{
+    STAT_CREATE,
+    STAT_CLONE,/*includes the clones made by bitmap_check*/
+    STAT_CHECK,
+    STAT_ADD,
+    STAT_DEL,
+    STAT_NOT,
+    STAT_OR,
+    STAT_AND,
+    STAT_XOR,
+    STAT_COPY,
+    STAT_CLEAR,
+    STAT_LOAD,
+    STAT_INTERSECT,/*bitmap_and_count, bitmap_jaccard, bitmap_hamming, bitmap_containment*/
+    STAT_PRINT,
+    STAT_PARSE,
+    STAT_FIRST_UPDATE,
+    STAT_LAST_UPDATE,
+    STAT_OP_COUNT
+}bitmap_stat_op_t;
+
+typedef struct
+{
+    u64 calls;
+    u64 words;/*buffer blocks read or written*/
+    u64 allocations;
+    u64 bytes;
+    u64 latency_total;/*ticks, see bitmap_stats_t.latency_unit*/
+    u64 latency_hist[BITMAP_STATS_BUCKETS];
+}bitmap_op_stats_t;
+
+typedef struct
+{
+    const char *latency_unit;/*"ns", "cycles" or NULL when latency is not recorded*/
+    bitmap_op_stats_t ops[STAT_OP_COUNT];
+}bitmap_stats_t;
+
+extern bool bitmap_stats_snapshot(bitmap_stats_t *stats);
+extern void bitmap_stats_reset(void);
+extern const char* bitmap_stats_op_name(bitmap_stat_op_t op);
+
+/*
+ * hooks used by the library, built with -DBITMAP_STATS they update counters private to the calling thread, otherwise
+ * they expand to nothing. -DBITMAP_STATS_LATENCY adds a clock_gettime latency histogram per API, or an rdtsc one
+ * with -DBITMAP_STATS_RDTSC on x86. every counter update is a relaxed atomic add, so a concurrent snapshot or reset
+ * sees it either whole or not at all.
+ */
+#ifdef BITMAP_STATS
+    typedef struct
+    {
+        bitmap_stat_op_t op;
+        u64 start;
+    }bitmap_stats_scope_t;
+
+    extern bitmap_op_stats_t* bitmap_stats_local(bitmap_stat_op_t op);
+    extern void bitmap_stats_scope_end(bitmap_stats_scope_t *scope);
+    extern u64 bitmap_stats_ticks(void);
+
+    #define STATS_COUNT(counter, n) ((void)__atomic_fetch_add(&(counter), (u64)(n), __ATOMIC_RELAXED))
+    #define STATS_WORDS(op, n) STATS_COUNT(bitmap_stats_local(op)->words, (n))
+    #define STATS_ALLOC(op, n) \
+        do \
+        { \
+            STATS_COUNT(bitmap_stats_local(op)->allocations, 1); \
+            STATS_COUNT(bitmap_stats_local(op)->bytes, (n)); \
+        } while(0)
+    #ifdef BITMAP_STATS_LATENCY
+        #define STATS_SCOPE(op) \
+            bitmap_stats_scope_t stats_scope __attribute__((cleanup(bitmap_stats_scope_end))) = {(op), bitmap_stats_ticks()}; \
+            STATS_COUNT(bitmap_stats_local(op)->calls, 1)
+    #else
+        #define STATS_SCOPE(op) STATS_COUNT(bitmap_stats_local(op)->calls, 1)
+    #endif
+#else
+    #define STATS_WORDS(op, n)
+    #define STATS_ALLOC(op, n)
+    #define STATS_SCOPE(op)
+#endif
+
+#endif/*__STATS_H__*/
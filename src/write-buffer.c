@@ -0,0 +1,248 @@
+#include "write-buffer.h"
+#include "error.h"
+
+#define BLOCK_INDEX(val) (((val) - 1U) >> 5U)
+#define MASK(val) (1U << (((val) - 1U) & 0x1FU))
+#define LOG_VALUE(entry) ((u16)((entry) >> 16U))
+#define LOG_SEQ(entry) ((u16)(entry))
+#define RADIX_BUCKETS 256U
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+static bool buffer_append(struct bitmap_buffer *buffer, u16 value, bool set);
+static void sort_log(struct bitmap_buffer *buffer);
+static u16 scan_first(struct bitmap *bm, u16 from_block);
+static u16 scan_last(struct bitmap *bm, u16 from_block);
+
+/*size 0 picks BITMAP_BUFFER_DEFAULT_SIZE*/
+struct bitmap_buffer* bitmap_buffer_create(struct bitmap *bm, u16 size)
+{
+    struct bitmap_buffer *buffer = NULL;
+
+    if(bm == NULL || bm != bm->bm_self)
+        return NULL;
+
+    buffer = (struct bitmap_buffer*)calloc(1, sizeof(struct bitmap_buffer));
+
+    if(buffer == NULL)
+        return NULL;
+
+    buffer->size = size == 0 ? BITMAP_BUFFER_DEFAULT_SIZE : size;
+    buffer->log = (u32*)malloc(buffer->size * sizeof(u32));
+    buffer->sort_tmp = (u32*)malloc(buffer->size * sizeof(u32));
+    buffer->set = (u8*)malloc(buffer->size);
+
+    if(buffer->log == NULL || buffer->sort_tmp == NULL || buffer->set == NULL)
+    {
+        free(buffer->log);
+        free(buffer->sort_tmp);
+        free(buffer->set);
+        free(buffer);
+        return NULL;
+    }
+
+    buffer->buf_self = buffer;
+    buffer->bm = bm;
+
+    return buffer;
+}
+
+/*pending updates are flushed, the bitmap itself is left alone*/
+void bitmap_buffer_destroy(struct bitmap_buffer *buffer)
+{
+    if(buffer == NULL || buffer != buffer->buf_self)
+    {
+        HALT_AND_CONTINUE("buffer not freed!");
+        return;
+    }
+
+    bitmap_buffer_flush(buffer);
+    free(buffer->log);
+    free(buffer->sort_tmp);
+    free(buffer->set);
+    free(buffer);
+
+    return;
+}
+
+bool bitmap_buffer_add(struct bitmap_buffer *buffer, u16 value)
+{
+    return buffer_append(buffer, value, true);
+}
+
+bool bitmap_buffer_del(struct bitmap_buffer *buffer, u16 value)
+{
+    return buffer_append(buffer, value, false);
+}
+
+/********************************************************************************************************************
+ * Function Name:       bitmap_buffer_flush
+ * Input:               buffer
+ * Output:              true on success, false on an invalid buffer
+ * Description          sorts the log by value keeping the arrival order of equal values, folds the updates of each
+ *                      block into one set and one clear mask, writes every touched block once and updates
+ *                      numbers, first_value and last_value a single time
+ ********************************************************************************************************************/
+bool bitmap_buffer_flush(struct bitmap_buffer *buffer)
+{
+    struct bitmap *bm = NULL;
+    u32 set_mask = 0;
+    u32 clear_mask = 0;
+    u32 block_value = 0;
+    u16 lowest_set = UINT16_MAX;
+    u16 highest_set = 0;
+    u16 block = 0;
+    u16 value = 0;
+    u16 i = 0;
+    bool set = false;
+
+    if(buffer == NULL || buffer != buffer->buf_self)
+        return false;
+
+    if(buffer->len == 0)
+        return true;
+
+    bm = buffer->bm;
+    sort_log(buffer);
+
+    for(i = 0; i < buffer->len; i++)
+    {
+        value = LOG_VALUE(buffer->log[i]);
+
+        if(i + 1U < buffer->len && LOG_VALUE(buffer->log[i + 1U]) == value)/*a later update of the same value wins*/
+            continue;
+
+        set = buffer->set[LOG_SEQ(buffer->log[i])];
+        block = BLOCK_INDEX(value);
+
+        if(set)
+        {
+            set_mask |= MASK(value);
+            clear_mask &= ~MASK(value);
+            lowest_set = MIN(lowest_set, value);
+            highest_set = MAX(highest_set, value);
+        }
+        else
+        {
+            clear_mask |= MASK(value);
+            set_mask &= ~MASK(value);
+        }
+
+        if(i + 1U < buffer->len && BLOCK_INDEX(LOG_VALUE(buffer->log[i + 1U])) == block)
+            continue;
+
+        block_value = (bm->buf[block] & ~clear_mask) | set_mask;
+        bm->numbers = bm->numbers - __builtin_popcount(bm->buf[block]) + __builtin_popcount(block_value);
+        bm->buf[block] = block_value;
+        set_mask = clear_mask = 0;
+    }
+
+    buffer->len = 0;
+
+    if(bm->numbers == 0)
+    {
+        bm->first_value = bm->last_value = 0;
+        return true;
+    }
+
+    /*nothing below the old first or above the old last can be set, except the values added now*/
+    bm->first_value = scan_first(bm, BLOCK_INDEX(bm->first_value == 0 ? lowest_set : MIN(bm->first_value, lowest_set)));
+    bm->last_value = scan_last(bm, BLOCK_INDEX(MAX(bm->last_value, highest_set)));
+
+    return true;
+}
+
+/*flushes and returns the bitmap, which stays owned by the caller of bitmap_buffer_create*/
+struct bitmap* bitmap_buffer_get(struct bitmap_buffer *buffer)
+{
+    if(bitmap_buffer_flush(buffer) == false)
+        return NULL;
+
+    return buffer->bm;
+}
+
+/*membership including the pending updates, without flushing*/
+bool bitmap_buffer_contains(struct bitmap_buffer *buffer, u16 value)
+{
+    u16 i = 0;
+
+    if(buffer == NULL || buffer != buffer->buf_self || value == 0 || value > buffer->bm->max_value)
+        return false;
+
+    for(i = buffer->len; i > 0; i--)
+        if(LOG_VALUE(buffer->log[i - 1U]) == value)
+            return buffer->set[i - 1U];
+
+    return (buffer->bm->buf[BLOCK_INDEX(value)] & MASK(value)) != 0;
+}
+
+static bool buffer_append(struct bitmap_buffer *buffer, u16 value, bool set)
+{
+    if(buffer == NULL || buffer != buffer->buf_self || value == 0 || value > buffer->bm->max_value)
+        return false;
+
+    if(buffer->len == buffer->size && bitmap_buffer_flush(buffer) == false)
+        return false;
+
+    buffer->set[buffer->len] = set;
+    buffer->log[buffer->len] = (u32)value << 16U | buffer->len;
+    buffer->len++;
+
+    return true;
+}
+
+/*two stable counting passes over the value bytes, entries with equal values keep their sequence order*/
+static void sort_log(struct bitmap_buffer *buffer)
+{
+    u32 count[RADIX_BUCKETS] = {0};
+    u32 *src = buffer->log;
+    u32 *dst = buffer->sort_tmp;
+    u32 *tmp = NULL;
+    u32 sum = 0;
+    u32 digit = 0;
+    u16 shift = 0;
+    u16 i = 0;
+
+    for(shift = 16U; shift <= 24U; shift += 8U)
+    {
+        memset(count, 0, sizeof(count));
+
+        for(i = 0; i < buffer->len; i++)
+            count[(src[i] >> shift) & 0xFFU]++;
+
+        for(sum = 0, digit = 0; digit < RADIX_BUCKETS; digit++)
+        {
+            sum += count[digit];
+            count[digit] = sum - count[digit];
+        }
+
+        for(i = 0; i < buffer->len; i++)
+            dst[count[(src[i] >> shift) & 0xFFU]++] = src[i];
+
+        tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    return;/*an even number of passes leaves the result in buffer->log*/
+}
+
+static u16 scan_first(struct bitmap *bm, u16 from_block)
+{
+    u16 i = from_block;
+
+    while(bm->buf[i] == 0)/*numbers != 0, so a set block exists at or after from_block*/
+        i++;
+
+    return 32U * i + __builtin_ctz(bm->buf[i]) + 1U;
+}
+
+static u16 scan_last(struct bitmap *bm, u16 from_block)
+{
+    u16 i = from_block;
+
+    while(bm->buf[i] == 0)
+        i--;
+
+    return 32U * i + (31U - __builtin_clz(bm->buf[i])) + 1U;
+}
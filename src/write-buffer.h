@@ -0,0 +1,28 @@
+#ifndef __WRITE_BUFFER_H__
+#define __WRITE_BUFFER_H__
+
+#include "bit-map.h"
+
+#define BITMAP_BUFFER_DEFAULT_SIZE 1024U
+
+/*stages single value updates of bm and applies them block by block, the last update of a value wins*/
+struct bitmap_buffer
+{
+    struct bitmap_buffer *buf_self;
+    struct bitmap *bm;
+    u16 size;
+    u16 len;
+    u32 *log;/*value << 16 | sequence number*/
+    u32 *sort_tmp;
+    u8 *set;/*indexed by sequence number, 1 for add, 0 for delete*/
+};
+
+extern struct bitmap_buffer* bitmap_buffer_create(struct bitmap *bm, u16 size);
+extern void bitmap_buffer_destroy(struct bitmap_buffer *buffer);
+extern bool bitmap_buffer_add(struct bitmap_buffer *buffer, u16 value);
+extern bool bitmap_buffer_del(struct bitmap_buffer *buffer, u16 value);
+extern bool bitmap_buffer_flush(struct bitmap_buffer *buffer);
+extern struct bitmap* bitmap_buffer_get(struct bitmap_buffer *buffer);
+extern bool bitmap_buffer_contains(struct bitmap_buffer *buffer, u16 value);
+
+#endif/*__WRITE_BUFFER_H__*/
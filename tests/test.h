@@ -0,0 +1,33 @@
+#ifndef __TEST_H__
+#define __TEST_H__
+
+#include "bit-map.h"
+
+#define CHECK(cond) \
+    do \
+    { \
+        if(!(cond)) \
+        { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while(0)
+
+/*exit status of a test binary*/
+#define TEST_RESULT() \
+    (failures == 0 ? 0 : (fprintf(stderr, "%u check(s) failed\n", failures), 1))
+
+static u32 failures = 0;
+
+static inline bool has_value(struct bitmap *bm, u16 value)
+{
+    return (bm->buf[(value - 1U) >> 5U] >> ((value - 1U) & 0x1FU)) & 1U;
+}
+
+static inline bool same_bitmap(struct bitmap *bm1, struct bitmap *bm2)
+{
+    return bm1->max_value == bm2->max_value && bm1->numbers == bm2->numbers && bm1->first_value == bm2->first_value
+        && bm1->last_value == bm2->last_value && memcmp(bm1->buf, bm2->buf, bm1->buf_len * sizeof(u32)) == 0;
+}
+
+#endif/*__TEST_H__*/
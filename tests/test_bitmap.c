@@ -0,0 +1,36 @@
+#include "test.h"
+
+static void test_core(void)
+{
+    struct bitmap *bm1 = bitmap_parse_str("20,25-75,150");
+    struct bitmap *bm2 = bitmap_parse_str("1-40,50,60-80");
+    struct bitmap *empty = bitmap_create(150);
+
+    CHECK(bm1 != NULL && bm2 != NULL && empty != NULL);
+    CHECK(bm1->numbers == 53 && bm1->first_value == 20 && bm1->last_value == 150);
+    CHECK(bitmap_parse_str("5,3") == NULL);
+
+    CHECK(bitmap_del_value(bm2, 50) && bm2->numbers == 61 && has_value(bm2, 50) == false);
+    CHECK(bitmap_del_value(bm2, 1) && bm2->first_value == 2);
+    CHECK(bitmap_add_value(bm2, 1) && bm2->first_value == 1);
+
+    CHECK(bitmap_not(bm1) && bm1->numbers == 97 && bm1->first_value == 1 && bm1->last_value == 149);
+    CHECK(bitmap_and(bm1, bm2) && bm1->numbers == 28 && bm1->first_value == 1 && bm1->last_value == 80);
+    CHECK(bitmap_or(bm2, bm1) && bm2->numbers == 61);
+    CHECK(bitmap_xor(bm2, bm1) && bm2->numbers == 33 && bm2->first_value == 20 && bm2->last_value == 75);
+
+    CHECK(bitmap_or(empty, bm2) && empty->numbers == 33 && empty->first_value == 20 && empty->last_value == 75);
+    CHECK(bitmap_clear(empty) && empty->numbers == 0 && empty->first_value == 0);
+    CHECK(bitmap_and(bm2, empty) && bm2->numbers == 0 && bm2->first_value == 0 && bm2->last_value == 0);
+
+    bitmap_destroy(bm1);
+    bitmap_destroy(bm2);
+    bitmap_destroy(empty);
+}
+
+int main()
+{
+    test_core();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,119 @@
+#include "test.h"
+#include "bsi.h"
+#include "stats.h"
+
+#define TIE_ROWS 65535U
+
+static void test_queries(void)
+{
+    u32 values[200] = {0};
+    struct bsi *index = NULL;
+    struct bitmap *result = NULL;
+    u64 sum = 0;
+    u64 expected_sum = 0;
+    u16 expected = 0;
+    u16 i = 0;
+
+    for(i = 0; i < 200; i++)
+    {
+        values[i] = (i * 37U) % 101U;
+        expected_sum += values[i];
+        expected += values[i] >= 20 && values[i] <= 60;
+    }
+
+    index = bsi_build(values, 200);
+    CHECK(index != NULL);
+
+    result = bsi_between(index, 20, 60);
+    CHECK(result != NULL && result->numbers == expected);
+
+    for(i = 1; result != NULL && i <= 200; i++)
+        CHECK(has_value(result, i) == (values[i - 1] >= 20 && values[i - 1] <= 60));
+
+    bitmap_destroy(result);
+
+    result = bsi_eq(index, 100);
+    CHECK(result != NULL && result->numbers == 2);
+    bitmap_destroy(result);
+
+    result = bsi_lt(index, 1000);
+    CHECK(result != NULL && result->numbers == 200);
+    bitmap_destroy(result);
+
+    CHECK(bsi_sum(index, NULL, &sum) && sum == expected_sum);
+
+    result = bsi_topk(index, NULL, 3);
+    CHECK(result != NULL && result->numbers == 3);
+
+    for(i = 1; result != NULL && i <= 200; i++)
+        if(has_value(result, i))
+            CHECK(values[i - 1] >= 99);
+
+    bitmap_destroy(result);
+    bsi_destroy(index);
+}
+
+static void test_topk_ties(void)
+{
+    u32 *values = (u32*)malloc(TIE_ROWS * sizeof(u32));
+    struct bsi *index = NULL;
+    struct bitmap *result = NULL;
+    u32 i = 0;
+
+    for(i = 0; i < TIE_ROWS; i++)
+        values[i] = 7;
+
+    values[40000] = values[50000] = 9;
+    index = bsi_build(values, TIE_ROWS);
+
+#ifdef BITMAP_STATS
+    bitmap_stats_t stats = {0};
+
+    bitmap_stats_reset();
+#endif
+    result = bsi_topk(index, NULL, 10);
+#ifdef BITMAP_STATS
+    bitmap_stats_snapshot(&stats);
+    CHECK(stats.ops[STAT_DEL].calls == 0 && stats.ops[STAT_CHECK].calls == 0);/*ties are trimmed in one pass, not row by row*/
+    CHECK(stats.ops[STAT_CLONE].calls == 1);/*only the tied rows*/
+#endif
+    CHECK(result != NULL && result->numbers == 10 && result->first_value == 1 && result->last_value == 50001);
+    CHECK(result != NULL && has_value(result, 8) && has_value(result, 40001) && has_value(result, 9) == false);
+    bitmap_destroy(result);
+
+#ifdef BITMAP_STATS
+    bitmap_stats_reset();
+#endif
+    result = bsi_between(index, 8, 9);
+#ifdef BITMAP_STATS
+    bitmap_stats_snapshot(&stats);
+    CHECK(stats.ops[STAT_CLONE].calls == 0 && stats.ops[STAT_CHECK].calls == 0);/*the slices are combined in place*/
+#endif
+    CHECK(result != NULL && result->numbers == 2 && has_value(result, 40001) && has_value(result, 50001));
+    bitmap_destroy(result);
+
+    bsi_destroy(index);
+    free(values);
+}
+
+static void test_keep_first(void)
+{
+    struct bitmap *bm = bitmap_parse_str("3,10-40,70-100,500");
+
+    CHECK(bitmap_keep_first(bm, 40) && bm->numbers == 40 && bm->first_value == 3 && bm->last_value == 77);
+    CHECK(has_value(bm, 77) && has_value(bm, 78) == false && has_value(bm, 500) == false);
+    CHECK(bitmap_keep_first(bm, 32) && bm->numbers == 32 && bm->last_value == 40);
+    CHECK(bitmap_keep_first(bm, 100) && bm->numbers == 32);
+    CHECK(bitmap_keep_first(bm, 0) && bm->numbers == 0 && bm->first_value == 0 && bm->last_value == 0);
+
+    bitmap_destroy(bm);
+}
+
+int main()
+{
+    test_queries();
+    test_topk_ties();
+    test_keep_first();
+
+    return TEST_RESULT();
+}
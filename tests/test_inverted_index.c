@@ -0,0 +1,117 @@
+#include "test.h"
+#include "inverted-index.h"
+#include "stats.h"
+
+#define STATS_DOCS 60000U
+
+static void test_queries(void)
+{
+    struct inv_index *index = inv_index_create(100);
+    struct bitmap *result = NULL;
+    u16 doc = 0;
+
+    for(doc = 1; doc <= 100; doc++)
+    {
+        if(doc % 2 == 0)
+            inv_index_add(index, "even", doc);
+        if(doc % 3 == 0)
+            inv_index_add(index, "three", doc);
+        if(doc <= 10)
+            inv_index_add(index, "low", doc);
+    }
+
+    CHECK(inv_index_get(index, "even") != NULL && inv_index_get(index, "even")->numbers == 50);
+    CHECK(inv_index_get(index, "odd") == NULL);
+
+    result = inv_index_query(index, "low & (three | even) & ~even");
+    CHECK(result != NULL && result->numbers == 2 && has_value(result, 3) && has_value(result, 9));
+    bitmap_destroy(result);
+
+    result = inv_index_query(index, "missing | low");
+    CHECK(result != NULL && result->numbers == 10);
+    bitmap_destroy(result);
+
+    CHECK(inv_index_query(index, "low & (even") == NULL);
+
+    inv_index_destroy(index);
+}
+
+static void test_doc_range(void)
+{
+    struct inv_index *index = inv_index_create(100);
+
+    CHECK(inv_index_add(index, "a", 0) == false);
+    CHECK(inv_index_add(index, "a", 101) == false);
+    CHECK(inv_index_get(index, "a") == NULL && index->term_count == 0);/*no empty term is left behind*/
+    CHECK(inv_index_add(index, "a", 100) && inv_index_get(index, "a")->numbers == 1);
+    CHECK(inv_index_del(index, "a", 101) == false);
+
+    inv_index_destroy(index);
+}
+
+/*every operator of a query against a reference built with the checked bitmap operations*/
+static void test_operators(void)
+{
+    struct inv_index *index = inv_index_create(STATS_DOCS);
+    struct bitmap *result = NULL;
+    struct bitmap *expected = NULL;
+    struct bitmap *tmp = NULL;
+    u32 doc = 0;
+
+    for(doc = 1; doc <= STATS_DOCS; doc++)
+    {
+        if(doc % 7 == 0)
+            inv_index_add(index, "a", doc);
+        if(doc % 11 == 0 || doc > 50000)
+            inv_index_add(index, "b", doc);
+        if(doc % 13 == 0 && doc < 20000)
+            inv_index_add(index, "c", doc);
+        if(doc % 2 == 0)
+            inv_index_add(index, "d", doc);
+    }
+
+    expected = bitmap_clone(inv_index_get(index, "b"));
+    bitmap_or(expected, inv_index_get(index, "c"));
+    bitmap_and(expected, inv_index_get(index, "a"));
+    tmp = bitmap_clone(inv_index_get(index, "d"));
+    bitmap_not(tmp);
+    bitmap_and(expected, tmp);
+
+#ifdef BITMAP_STATS
+    bitmap_stats_t stats = {0};
+
+    bitmap_destroy(inv_index_query(index, "a & (b | c) & ~d"));/*the first query creates the scratch bitmaps*/
+    bitmap_stats_reset();
+#endif
+    result = inv_index_query(index, "a & (b | c) & ~d");
+#ifdef BITMAP_STATS
+    bitmap_stats_snapshot(&stats);
+    CHECK(stats.ops[STAT_CLONE].calls == 0 && stats.ops[STAT_CHECK].calls == 0 && stats.ops[STAT_CREATE].calls == 1);/*only the result*/
+#endif
+    CHECK(result != NULL && same_bitmap(result, expected));
+    bitmap_destroy(result);
+
+    bitmap_not(tmp);/*back to d*/
+    bitmap_not(expected);
+    bitmap_and(expected, tmp);/*~(a & (b | c) & ~d) & d == d*/
+    result = inv_index_query(index, "~(a & (b | c) & ~d) & d");
+    CHECK(result != NULL && same_bitmap(result, expected) && same_bitmap(result, tmp));
+    bitmap_destroy(result);
+
+    result = inv_index_query(index, "~a | ~zzz");
+    CHECK(result != NULL && result->numbers == STATS_DOCS);
+    bitmap_destroy(result);
+
+    bitmap_destroy(expected);
+    bitmap_destroy(tmp);
+    inv_index_destroy(index);
+}
+
+int main()
+{
+    test_queries();
+    test_doc_range();
+    test_operators();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,131 @@
+#include "test.h"
+#include "patch.h"
+
+#define NEW_FIRST_OFFSET 19U
+#define NEW_LAST_OFFSET 21U
+#define NEW_NUMBERS_OFFSET 23U
+
+static void test_tracker(void)
+{
+    struct bitmap *bm = bitmap_parse_str("1-3000,9000");
+    struct bitmap *replica = bitmap_clone(bm);
+    struct bitmap_tracker *tracker = bitmap_tracker_create(bm);
+    bitmap_patch_t patch = {0};
+    u32 seq = 0;
+    u16 value = 0;
+
+    for(value = 100; value <= 2000; value++)
+        bitmap_tracker_del_value(tracker, value);
+
+    bitmap_tracker_add_value(tracker, 5000);
+
+    CHECK(bitmap_tracker_emit(tracker, &patch) && patch.len < 64);
+    CHECK(bitmap_apply_patch(replica, &seq, &patch) && same_bitmap(replica, bm) && seq == 1);
+    CHECK(bitmap_apply_patch(replica, &seq, &patch) == false && same_bitmap(replica, bm) && seq == 1);/*already applied*/
+    bitmap_patch_free(&patch);
+
+    bitmap_tracker_del_value(tracker, 9000);
+    CHECK(bitmap_tracker_emit(tracker, &patch));/*based on the previous emit*/
+    CHECK(bitmap_apply_patch(replica, &seq, &patch) && same_bitmap(replica, bm) && seq == 2);
+    bitmap_patch_free(&patch);
+
+    bitmap_tracker_destroy(tracker);
+    bitmap_destroy(bm);
+    bitmap_destroy(replica);
+}
+
+/*the first patch keeps first/last/numbers, only the seq tells the versions apart*/
+static void test_skipped(void)
+{
+    struct bitmap *bm = bitmap_parse_str("1-10,500");
+    struct bitmap *replica = bitmap_clone(bm);
+    struct bitmap *before = bitmap_clone(bm);
+    struct bitmap_tracker *tracker = bitmap_tracker_create(bm);
+    bitmap_patch_t first = {0};
+    bitmap_patch_t second = {0};
+    u32 seq = 0;
+
+    bitmap_tracker_add_value(tracker, 100);
+    bitmap_tracker_del_value(tracker, 5);
+    CHECK(bitmap_tracker_emit(tracker, &first));
+    bitmap_tracker_add_value(tracker, 300);
+    CHECK(bitmap_tracker_emit(tracker, &second));
+
+    CHECK(bitmap_apply_patch(replica, &seq, &second) == false && same_bitmap(replica, before) && seq == 0);
+    CHECK(bitmap_apply_patch(replica, &seq, &first) && bitmap_apply_patch(replica, &seq, &second));
+    CHECK(same_bitmap(replica, bm) && seq == 2);
+
+    bitmap_patch_free(&first);
+    bitmap_patch_free(&second);
+    bitmap_tracker_destroy(tracker);
+    bitmap_destroy(bm);
+    bitmap_destroy(replica);
+    bitmap_destroy(before);
+}
+
+/*applies a copy of patch with the u16 at offset replaced, it must be rejected without touching bm*/
+static bool tampered_rejected(struct bitmap *bm, const bitmap_patch_t *patch, u32 offset, u16 value)
+{
+    struct bitmap *before = bitmap_clone(bm);
+    bitmap_patch_t bad = {0};
+    u32 seq = 0;
+    bool rejected = false;
+
+    bad.data = (u8*)malloc(patch->len);
+    bad.len = patch->len;
+    memcpy(bad.data, patch->data, patch->len);
+    bad.data[offset] = (u8)value;
+    bad.data[offset + 1U] = (u8)(value >> 8);
+
+    rejected = bitmap_apply_patch(bm, &seq, &bad) == false && seq == 0 && same_bitmap(bm, before);
+
+    free(bad.data);
+    bitmap_destroy(before);
+
+    return rejected;
+}
+
+static void test_rejected(void)
+{
+    struct bitmap *old = bitmap_parse_str("1-100,500");
+    struct bitmap *new = bitmap_parse_str("1-50,500");
+    struct bitmap *other = bitmap_parse_str("200-300,500");
+    struct bitmap *before = bitmap_clone(other);
+    bitmap_patch_t patch = {0};
+    bitmap_patch_t bad = {0};
+    u32 seq = 0;
+
+    CHECK(bitmap_diff(old, 0, new, 0, &patch) == false);/*the versions need distinct seqs*/
+    CHECK(bitmap_diff(old, 0, new, 1, &patch));
+    CHECK(bitmap_apply_patch(other, &seq, &patch) == false && same_bitmap(other, before) && seq == 0);/*another version*/
+
+    bitmap_destroy(before);
+    before = bitmap_clone(old);
+
+    bad.data = patch.data;
+    bad.len = patch.len - 1U;/*truncated record*/
+    CHECK(bitmap_apply_patch(old, &seq, &bad) == false && same_bitmap(old, before) && seq == 0);
+
+    CHECK(tampered_rejected(old, &patch, NEW_NUMBERS_OFFSET, 53));/*resulting numbers do not match the records*/
+    CHECK(tampered_rejected(old, &patch, NEW_FIRST_OFFSET, 2));/*value 1 is still set*/
+    CHECK(tampered_rejected(old, &patch, NEW_LAST_OFFSET, 499));/*value 500 is still set*/
+    CHECK(tampered_rejected(old, &patch, NEW_LAST_OFFSET, 50));/*the block of 500 is left outside*/
+    CHECK(tampered_rejected(old, &patch, NEW_FIRST_OFFSET, 0));
+
+    CHECK(bitmap_apply_patch(old, &seq, &patch) && same_bitmap(old, new) && seq == 1);
+    bitmap_patch_free(&patch);
+
+    bitmap_destroy(old);
+    bitmap_destroy(new);
+    bitmap_destroy(other);
+    bitmap_destroy(before);
+}
+
+int main()
+{
+    test_tracker();
+    test_skipped();
+    test_rejected();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,94 @@
+#include "test.h"
+#include "similarity.h"
+
+#define LARGE_COLLECTION 40000U/*above TOPK_MIN_PER_THREAD so the collection is split*/
+#define LARGE_CAPACITY 256U
+
+static void test_metrics(void)
+{
+    struct bitmap *collection[4] = {0};
+    bitmap_match_t matches[3] = {{0}};
+    struct bitmap *query = bitmap_parse_str("1-10,20");
+    double score = 0;
+    u32 count = 0;
+
+    collection[0] = bitmap_parse_str("5-15,40");
+    collection[1] = bitmap_parse_str("30-40");
+    collection[2] = bitmap_parse_str("1-10,20");
+    collection[3] = bitmap_parse_str("1-10");
+
+    CHECK(bitmap_and_count(query, collection[0], &count) && count == 6);
+    CHECK(bitmap_hamming(query, collection[0], &count) && count == 11);
+    CHECK(bitmap_jaccard(query, collection[0], &score) && score > 0.3529 && score < 0.353);
+    CHECK(bitmap_containment(collection[3], query, &score) && score == 1.0);
+
+    CHECK(bitmap_topk_similar(query, collection, 4, 3, matches) == 3);
+    CHECK(matches[0].index == 2 && matches[0].score == 1.0);
+    CHECK(matches[1].index == 3 && matches[2].index == 0);
+    CHECK(bitmap_topk_similar(query, collection, 3, 1U << 30, matches) == 3);/*heaps are sized by the collection, not k*/
+    CHECK(matches[0].index == 2 && matches[1].index == 0 && matches[2].index == 1);
+    CHECK(bitmap_topk_similar(NULL, collection, 4, 3, matches) == BITMAP_TOPK_ERROR);
+    CHECK(bitmap_topk_similar(query, collection, 0, 3, matches) == 0);
+
+    for(count = 0; count < 4; count++)
+        bitmap_destroy(collection[count]);
+
+    bitmap_destroy(query);
+}
+
+static void test_topk_threads(void)
+{
+    struct bitmap **collection = (struct bitmap**)calloc(LARGE_COLLECTION, sizeof(struct bitmap*));
+    bitmap_match_t single[8] = {{0}};
+    bitmap_match_t split[8] = {{0}};
+    u32 words[LARGE_CAPACITY / 32U] = {0};
+    struct bitmap *query = NULL;
+    u32 state = 2463534242U;
+    u32 i = 0;
+    u32 w = 0;
+
+    for(i = 0; i < LARGE_COLLECTION; i++)
+    {
+        for(w = 0; w < LARGE_CAPACITY / 32U; w++)
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            words[w] = state & (state >> 3);/*about a quarter of the bits*/
+        }
+
+        collection[i] = bitmap_create(LARGE_CAPACITY);
+        bitmap_load_words(collection[i], words, LARGE_CAPACITY / 32U);
+    }
+
+    query = bitmap_clone(collection[31000]);
+    bitmap_copy(collection[5], query);
+    bitmap_copy(collection[6], query);/*invalid right after a perfect match, it must not inherit its score*/
+    collection[6]->buf_len = 0;
+
+    CHECK(bitmap_topk_similar_threads(query, collection, LARGE_COLLECTION, 8, 1, single) == 8);
+    CHECK(bitmap_topk_similar_threads(query, collection, LARGE_COLLECTION, 8, 4, split) == 8);
+    CHECK(split[0].index == 5 && split[1].index == 31000 && split[1].score == 1.0 && split[2].score < 1.0);
+
+    for(i = 0; i < 8; i++)
+        CHECK(split[i].index == single[i].index && split[i].score == single[i].score && split[i].index != 6);
+
+    for(i = 1; i < 8; i++)
+        CHECK(split[i - 1].score >= split[i].score);
+
+    collection[6]->buf_len = LARGE_CAPACITY / 32U;
+
+    for(i = 0; i < LARGE_COLLECTION; i++)
+        bitmap_destroy(collection[i]);
+
+    free(collection);
+    bitmap_destroy(query);
+}
+
+int main()
+{
+    test_metrics();
+    test_topk_threads();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,70 @@
+#include <pthread.h>
+#include "test.h"
+#include "stats.h"
+
+static void* create_one(void *arg)
+{
+    (void)arg;
+    bitmap_destroy(bitmap_create(100));
+
+    return NULL;
+}
+
+static void test_counters(void)
+{
+    bitmap_stats_t stats = {0};
+    struct bitmap *bm = NULL;
+
+    bitmap_stats_reset();
+    bm = bitmap_create(100);
+    bitmap_add_value(bm, 5);
+    bitmap_destroy(bm);
+
+#ifdef BITMAP_STATS
+    CHECK(bitmap_stats_snapshot(&stats));
+    CHECK(stats.ops[STAT_ADD].calls == 1 && stats.ops[STAT_CHECK].calls == 1 && stats.ops[STAT_CLONE].calls == 1);
+    CHECK(stats.ops[STAT_CREATE].allocations == 1 && stats.ops[STAT_CREATE].bytes == bitmap_size(100));
+    CHECK(stats.ops[STAT_CLONE].allocations == 1 && stats.ops[STAT_CLONE].bytes == bitmap_size(100));/*the check clones*/
+    CHECK(stats.ops[STAT_CLONE].words == 4 && stats.ops[STAT_CHECK].words == 4);
+#ifdef BITMAP_STATS_LATENCY
+    CHECK(stats.latency_unit != NULL && stats.ops[STAT_ADD].latency_total > 0);
+#endif
+#else
+    CHECK(bitmap_stats_snapshot(&stats) == false && stats.ops[STAT_ADD].calls == 0);
+#endif
+}
+
+/*counts made by threads that already exited stay in the totals until a reset*/
+static void test_threads(void)
+{
+    bitmap_stats_t stats = {0};
+    pthread_t thread;
+    u32 i = 0;
+
+    bitmap_stats_reset();
+    bitmap_destroy(bitmap_create(100));
+
+    for(i = 0; i < 64; i++)
+    {
+        CHECK(pthread_create(&thread, NULL, create_one, NULL) == 0);
+        pthread_join(thread, NULL);
+    }
+
+#ifdef BITMAP_STATS
+    CHECK(bitmap_stats_snapshot(&stats));
+    CHECK(stats.ops[STAT_CREATE].calls == 65 && stats.ops[STAT_CREATE].allocations == 65);
+    bitmap_stats_reset();/*clears the exited threads too*/
+    CHECK(bitmap_stats_snapshot(&stats));
+    CHECK(stats.ops[STAT_CREATE].calls == 0 && stats.ops[STAT_CREATE].allocations == 0);
+#else
+    CHECK(bitmap_stats_snapshot(&stats) == false);
+#endif
+}
+
+int main()
+{
+    test_counters();
+    test_threads();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,71 @@
+#include "test.h"
+#include "write-buffer.h"
+
+static void test_updates(void)
+{
+    struct bitmap *bm = bitmap_parse_str("10-20,500");
+    struct bitmap *expected = bitmap_clone(bm);
+    struct bitmap_buffer *buffer = bitmap_buffer_create(bm, 8);
+    u16 value = 0;
+
+    for(value = 1; value <= 40; value++)
+    {
+        bitmap_buffer_add(buffer, value);
+        bitmap_add_value(expected, value);
+    }
+
+    bitmap_buffer_del(buffer, 500);
+    bitmap_del_value(expected, 500);
+    bitmap_buffer_del(buffer, 1);
+    bitmap_buffer_add(buffer, 1);
+
+    CHECK(bitmap_buffer_add(buffer, 501) == false && bitmap_buffer_del(buffer, 0) == false);
+    CHECK(bitmap_buffer_contains(buffer, 1) && bitmap_buffer_contains(buffer, 500) == false);
+    CHECK(same_bitmap(bitmap_buffer_get(buffer), expected));
+
+    bitmap_buffer_destroy(buffer);
+    bitmap_destroy(bm);
+    bitmap_destroy(expected);
+}
+
+/*the last update of a value wins across sort passes, and destroy flushes what is still pending*/
+static void test_last_update_wins(void)
+{
+    struct bitmap *bm = bitmap_create(65535);
+    struct bitmap *expected = bitmap_create(65535);
+    struct bitmap_buffer *buffer = bitmap_buffer_create(bm, 0);
+    u32 seed = 12345;
+    u32 i = 0;
+    u16 value = 0;
+
+    for(i = 0; i < 5000; i++)
+    {
+        seed = seed * 1103515245U + 12345U;
+        value = (u16)((seed >> 8) % 2000U + 1U) * 31U;/*repeats often, spans both sort bytes*/
+
+        if((seed >> 30) & 1U)
+        {
+            bitmap_buffer_add(buffer, value);
+            bitmap_add_value(expected, value);
+        }
+        else
+        {
+            bitmap_buffer_del(buffer, value);
+            bitmap_del_value(expected, value);
+        }
+    }
+
+    bitmap_buffer_destroy(buffer);
+    CHECK(same_bitmap(bm, expected));
+
+    bitmap_destroy(bm);
+    bitmap_destroy(expected);
+}
+
+int main()
+{
+    test_updates();
+    test_last_update_wins();
+
+    return TEST_RESULT();
+}